@@ -40,6 +40,8 @@ void Attacks::init() {
         PAWN_ATTACKS[1][i] = computePawnAttacks(i, false);
     }
 
+    // relies on the sliding attack tables
+    initLineTables();
 }
 
 uint64_t Attacks::rookAttacks(int square, uint64_t allPieces) {
@@ -63,6 +65,16 @@ uint64_t Attacks::kingAttacks(int square) {
     return KING_ATTACKS[square];
 }
 
+// squares strictly between two aligned squares; empty if the squares aren't aligned
+uint64_t Attacks::between(int square1, int square2) {
+    return BETWEEN[square1][square2];
+}
+
+// the entire rank, file, or diagonal going through both squares; empty if the squares aren't aligned
+uint64_t Attacks::line(int square1, int square2) {
+    return LINE[square1][square2];
+}
+
 int Attacks::getMagicIndex(Magic& entry, uint64_t allPieces) {
     const uint64_t blockers = allPieces & entry.slideMask;
     return ((blockers * entry.magic) >> entry.shift) + entry.offset;
@@ -211,6 +223,28 @@ uint64_t Attacks::computePawnAttacks(int square, bool isWhiteTurn) {
     return isWhiteTurn ? upPawns : downPawns;
 }
 
+void Attacks::initLineTables() {
+    for (int sq1 = 0; sq1 < BOARD_SIZE; sq1++) {
+        for (int sq2 = 0; sq2 < BOARD_SIZE; sq2++) {
+            const uint64_t squares = (c_u64(1) << sq1) | (c_u64(1) << sq2);
+            BETWEEN[sq1][sq2] = 0;
+            LINE[sq1][sq2] = 0;
+            if (sq1 == sq2) {
+                continue;
+            }
+
+            if (rookAttacks(sq1, 0) & (c_u64(1) << sq2)) {
+                BETWEEN[sq1][sq2] = rookAttacks(sq1, squares) & rookAttacks(sq2, squares);
+                LINE[sq1][sq2] = (rookAttacks(sq1, 0) & rookAttacks(sq2, 0)) | squares;
+            }
+            else if (bishopAttacks(sq1, 0) & (c_u64(1) << sq2)) {
+                BETWEEN[sq1][sq2] = bishopAttacks(sq1, squares) & bishopAttacks(sq2, squares);
+                LINE[sq1][sq2] = (bishopAttacks(sq1, 0) & bishopAttacks(sq2, 0)) | squares;
+            }
+        }
+    }
+}
+
 // global attack tables
 std::array<Attacks::Magic, BOARD_SIZE> Attacks::ROOK_TABLE;
 std::array<Attacks::Magic, BOARD_SIZE> Attacks::BISHOP_TABLE;
@@ -219,6 +253,8 @@ std::array<uint64_t, 5248> Attacks::BISHOP_ATTACKS;
 std::array<std::array<uint64_t, BOARD_SIZE>, 2> Attacks::PAWN_ATTACKS;
 std::array<uint64_t, BOARD_SIZE> Attacks::KNIGHT_ATTACKS;
 std::array<uint64_t, BOARD_SIZE> Attacks::KING_ATTACKS;
+std::array<std::array<uint64_t, BOARD_SIZE>, BOARD_SIZE> Attacks::BETWEEN;
+std::array<std::array<uint64_t, BOARD_SIZE>, BOARD_SIZE> Attacks::LINE;
 
 // magics generation
 void Attacks::generateMagics() {
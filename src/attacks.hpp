@@ -19,6 +19,7 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -41,6 +42,10 @@ class Attacks {
         static uint64_t pawnAttacks(int square, bool isWhiteTurn);
         static uint64_t knightAttacks(int square);
         static uint64_t kingAttacks(int square);
+
+        // used to find pins and check blocking squares
+        static uint64_t between(int square1, int square2);
+        static uint64_t line(int square1, int square2);
     private:
         static int getMagicIndex(Magic& entry, uint64_t blockers);
         // not used to generate attacks
@@ -63,6 +68,7 @@ class Attacks {
         static uint64_t computeKnightAttacks(int square);
         static uint64_t computeKingAttacks(int square);
         static uint64_t computePawnAttacks(int square, bool isWhiteTurn);
+        static void initLineTables();
 
         // global attack tables
         static std::array<Magic, BOARD_SIZE> ROOK_TABLE;
@@ -72,6 +78,8 @@ class Attacks {
         static std::array<std::array<uint64_t, BOARD_SIZE>, 2> PAWN_ATTACKS;
         static std::array<uint64_t, BOARD_SIZE> KNIGHT_ATTACKS;
         static std::array<uint64_t, BOARD_SIZE> KING_ATTACKS;
+        static std::array<std::array<uint64_t, BOARD_SIZE>, BOARD_SIZE> BETWEEN;
+        static std::array<std::array<uint64_t, BOARD_SIZE>, BOARD_SIZE> LINE;
 };
 
 inline constexpr std::array<uint64_t, BOARD_SIZE> ROOK_MAGICS{
@@ -16,6 +16,9 @@
 * if not, see <https://www.gnu.org/licenses>.
 */
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstdint>
 #include <iostream>
 #include <string>
@@ -23,6 +26,8 @@
 
 #include "bench.hpp"
 #include "board.hpp"
+#include "moveGen.hpp"
+#include "moveOrder.hpp"
 #include "search.hpp"
 #include "timeman.hpp"
 
@@ -37,11 +42,68 @@ uint64_t start() {
     for (int i = 0; i < numPositions; ++i) {
         const auto fen = fens[i];
         std::cout << "Searching position " << (i + 1) << '/' << numPositions << ": " << fen << '\n';
-        Search::Searcher engine(Board(fen), Timeman::TimeManager(), BENCHDEPTH);
-        engine.setPrintInfo(false);
-        nodeCount += engine.startThinking().nodes;
+        nodeCount += Search::Threads.startThinking(Board(fen), Timeman::TimeManager(), BENCHDEPTH, false).nodes;
     }
     return nodeCount;
 }
 
+void movePicker() {
+    constexpr int ITERATIONS = 20000;
+
+    // gather move lists with spread out scores, similar to a history table
+    std::vector<std::vector<Move>> moveLists;
+    std::vector<std::vector<int>> scoreLists;
+    for (const auto& fen: fens) {
+        Board board(fen);
+        MoveList gen(board);
+        gen.generateAllMoves(board);
+        moveLists.emplace_back(gen.moves.begin(), gen.moves.end());
+        scoreLists.emplace_back();
+        for (const auto move: gen.moves) {
+            scoreLists.back().push_back((move.sqr1() * 31 + move.sqr2() * 17) % 2000 - 1000);
+        }
+    }
+
+    uint64_t picks = 0, checksum = 0;
+    std::array<Move, MAX_MOVES> moves;
+    std::array<int, MAX_MOVES> scores;
+    const auto selectionStart = std::chrono::high_resolution_clock::now();
+    for (int iteration = 0; iteration < ITERATIONS; ++iteration) {
+        for (size_t list = 0; list < moveLists.size(); ++list) {
+            const size_t size = moveLists[list].size();
+            std::copy(moveLists[list].begin(), moveLists[list].end(), moves.begin());
+            std::copy(scoreLists[list].begin(), scoreLists[list].end(), scores.begin());
+            for (size_t i = 0; i < size; ++i) {
+                const size_t maxIndex = std::distance(scores.begin(), std::max_element(scores.begin() + i, scores.begin() + size));
+                std::swap(scores[maxIndex], scores[i]);
+                std::swap(moves[maxIndex], moves[i]);
+                checksum += moves[i].getData();
+            }
+            picks += size;
+        }
+    }
+    const auto selectionEnd = std::chrono::high_resolution_clock::now();
+
+    std::array<int32_t, MAX_MOVES> entries;
+    const auto packedStart = std::chrono::high_resolution_clock::now();
+    for (int iteration = 0; iteration < ITERATIONS; ++iteration) {
+        for (size_t list = 0; list < moveLists.size(); ++list) {
+            const size_t size = moveLists[list].size();
+            for (size_t i = 0; i < size; ++i) {
+                entries[i] = MoveOrder::packEntry(moveLists[list][i], scoreLists[list][i]);
+            }
+            for (size_t i = 0; i < size; ++i) {
+                checksum += MoveOrder::unpackMove(MoveOrder::selectMaxEntry(entries.data(), i, size)).getData();
+            }
+        }
+    }
+    const auto packedEnd = std::chrono::high_resolution_clock::now();
+
+    const auto selectionNs = std::chrono::duration_cast<std::chrono::nanoseconds>(selectionEnd - selectionStart).count();
+    const auto packedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(packedEnd - packedStart).count();
+    std::cout << "Selection sort: " << static_cast<double>(selectionNs) / picks << " ns/pick\n";
+    std::cout << "Packed max scan: " << static_cast<double>(packedNs) / picks << " ns/pick\n";
+    std::cout << "Checksum: " << checksum << '\n';
+}
+
 } // namespace Bench
\ No newline at end of file
@@ -58,4 +58,8 @@ const std::vector<std::string> fens = {
 
 uint64_t start();
 
+// microbenchmark of picking every move in order from the move lists of the bench positions
+// compares the packed max scan used by the MovePicker with a selection sort over separate move and score arrays
+void movePicker();
+
 } // namespace Bench
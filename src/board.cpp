@@ -16,6 +16,7 @@
 * if not, see <https://www.gnu.org/licenses>.
 */
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <iostream>
@@ -30,6 +31,7 @@
 #include "bitboard.hpp"
 #include "zobrist.hpp"
 #include "eval.hpp" 
+#include "nnue.hpp"
 #include "utils/types.hpp"
 
 Board::Board(std::string fenStr) {
@@ -37,7 +39,7 @@ Board::Board(std::string fenStr) {
     std::istringstream fenStream(fenStr);
 
     this->m_zobristKey = 0;
-    this->m_zobristKeyHistory = {0}; // required for setPiece
+    this->m_zobristKeyHistory.push_back(0); // required for setPiece
 
     std::fill(this->m_board.begin(), this->m_board.end(), EmptyPiece);
     fenStream >> token;
@@ -52,7 +54,7 @@ Board::Board(std::string fenStr) {
         }
         else { // must be a piece character
             pieceTypes currPiece = charToPiece.at(iter); 
-            this->setPiece(toSquare(rank, file), currPiece);
+            this->placePiece(toSquare(rank, file), currPiece);
             file += 1;
         }
     }
@@ -141,7 +143,9 @@ void Board::initZobristKey() {
     if (!this->m_isWhiteTurn) {
         this->m_zobristKey ^= Zobrist::isBlackKey;
     }
-    this->m_zobristKeyHistory = {this->m_zobristKey}; // synchronize history and current key
+    // synchronize history and current key
+    this->m_zobristKeyHistory.clear();
+    this->m_zobristKeyHistory.push_back(this->m_zobristKey);
 }
 
 // makeMove will not check if the move is invalid
@@ -160,6 +164,7 @@ void Board::makeMove(Move move) {
     const pieceTypes originPiece = this->getPiece(pos1);
     const pieceTypes targetPiece = this->getPiece(pos2);
 
+    this->reserveHistory();
     this->m_moveHistory.push_back(BoardState(
         Move(pos1, pos2, promotionPiece),
         originPiece,
@@ -172,6 +177,7 @@ void Board::makeMove(Move move) {
     const Square oldEnPassSquare = this->m_enPassSquare;
     const castleRights oldCastlingRights = this->m_castlingRights;
 
+    this->pushEvalState();
     this->setPiece(pos1, EmptyPiece); // origin square should be cleared in all situations
     this->setPiece(pos2, originPiece); // pretty much all possible moves translates the original piece to pos2
 
@@ -259,21 +265,30 @@ void Board::undoMove() {
     const pieceTypes prevRook = this->m_isWhiteTurn ? BRook : WRook;
     const pieceTypes prevPawn = this->m_isWhiteTurn ? BPawn : WPawn;
 
-    this->setPiece(prev.move.sqr1(), prev.originPiece);
-    this->setPiece(prev.move.sqr2(), prev.targetPiece);
+    // the state below the top still describes the previous position, so nothing has to be undone
+    // the base has nothing below it and is rebuilt once it's needed again
+    if (this->m_evalStack.top > 0) {
+        --this->m_evalStack.top;
+    }
+    else if (this->m_evalStack.isAllocated()) {
+        this->m_evalStack.reset();
+    }
+
+    this->placePiece(prev.move.sqr1(), prev.originPiece);
+    this->placePiece(prev.move.sqr2(), prev.targetPiece);
 
     // castling
     if (prev.originPiece == prevKing && (prev.castlingRights & castleRightsBit(prev.move.sqr2(), !this->m_isWhiteTurn)) ) {
         const int kingFileDirection = prev.move.sqr2() > prev.move.sqr1() ? 1 : -1;
         const int rookFile = kingFileDirection == 1 ? 7 : 0;
-        this->setPiece(prev.move.sqr1() + kingFileDirection, EmptyPiece);
-        this->setPiece(prev.move.sqr1() - getFile(prev.move.sqr1()) + rookFile, prevRook);
+        this->placePiece(prev.move.sqr1() + kingFileDirection, EmptyPiece);
+        this->placePiece(prev.move.sqr1() - getFile(prev.move.sqr1()) + rookFile, prevRook);
     }
     // en passant
     else if (prev.originPiece == prevPawn && prev.move.sqr2() == prev.enPassSquare) {
         const int behindDirection = this->m_isWhiteTurn ? -8 : 8;
         const pieceTypes prevJumpedPawn = this->m_isWhiteTurn ? WPawn : BPawn;
-        this->setPiece(prev.move.sqr2() + behindDirection, prevJumpedPawn);
+        this->placePiece(prev.move.sqr2() + behindDirection, prevJumpedPawn);
     }
 
     this->m_isWhiteTurn = !this->m_isWhiteTurn;
@@ -287,6 +302,7 @@ void Board::undoMove() {
 }
 
 void Board::makeNullMove() {
+    this->reserveHistory();
     this->m_moveHistory.push_back(BoardState(
         Move(),
         EmptyPiece,
@@ -301,6 +317,7 @@ void Board::makeNullMove() {
     }
     this->m_isWhiteTurn = !this->m_isWhiteTurn;
     this->m_fiftyMoveRule++;
+    this->invalidateCheckInfo();
 
     this->m_zobristKey ^= Zobrist::isBlackKey;
     this->m_zobristKeyHistory.push_back(this->m_zobristKey);
@@ -310,6 +327,7 @@ void Board::unmakeNullMove() {
     this->m_enPassSquare = this->m_moveHistory.back().enPassSquare;
     this->m_isWhiteTurn = !this->m_isWhiteTurn;
     this->m_fiftyMoveRule--;
+    this->invalidateCheckInfo();
 
     this->m_moveHistory.pop_back();
     this->m_zobristKeyHistory.pop_back();
@@ -321,13 +339,25 @@ auto Board::getPiece(Square square) const -> pieceTypes{
     return this->m_board[square];
 }
 
-// handles board, pieceSets, and zobristKey (not including en passant and castling)
+// handles board, pieceSets, zobristKey (not including en passant and castling), and evaluation state
 void Board::setPiece(Square square, pieceTypes currPiece) {
+    const pieceTypes originPiece = this->getPiece(square);
+    this->placePiece(square, currPiece);
+    if (originPiece != EmptyPiece) {
+        this->markDirty(square, originPiece, false);
+    }
+    if (currPiece != EmptyPiece) {
+        this->markDirty(square, currPiece, true);
+    }
+}
+
+void Board::placePiece(Square square, pieceTypes currPiece) {
     const uint64_t setSquare = (c_u64(1) << square);
     const uint64_t clearSquare = ALL_SQUARES ^ setSquare;
 
     const pieceTypes originPiece = this->getPiece(square);
     this->m_board[square] = currPiece;
+    this->invalidateCheckInfo();
     
     if (originPiece != EmptyPiece) {
         const pieceTypes originColor = originPiece < BKing ? WHITE_PIECES : BLACK_PIECES;
@@ -335,7 +365,6 @@ void Board::setPiece(Square square, pieceTypes currPiece) {
         this->pieceSets[originColor] &= clearSquare;
         this->pieceSets[originPiece] &= clearSquare;
         this->m_zobristKey ^= Zobrist::pieceKeys[originPiece][square];
-        this->eval.removePiece(square, originPiece);
     }
     if (currPiece != EmptyPiece) {
         const pieceTypes currColor = currPiece < BKing ? WHITE_PIECES : BLACK_PIECES;
@@ -343,10 +372,197 @@ void Board::setPiece(Square square, pieceTypes currPiece) {
         this->pieceSets[currColor] ^= setSquare;
         this->pieceSets[currPiece] ^= setSquare;
         this->m_zobristKey ^= Zobrist::pieceKeys[currPiece][square];
-        this->eval.addPiece(square, currPiece);
     }
 }
 
+// at capacity the oldest half of the history is dropped; those moves are never undone and
+// their positions are far outside the fifty move window, so repetitions are still detected
+void Board::reserveHistory() {
+    if (this->m_moveHistory.size() == this->m_moveHistory.capacity()) [[unlikely]] {
+        this->m_moveHistory.dropFront(MAX_HISTORY / 2);
+        this->m_zobristKeyHistory.dropFront(MAX_HISTORY / 2);
+    }
+}
+
+// boards that were never evaluated don't track changes at all
+void Board::pushEvalState() {
+    if (!this->m_evalStack.isAllocated()) {
+        return;
+    }
+    if (this->m_evalStack.top == EVAL_STACK_SIZE - 1) {
+        // fold the whole stack into the base; undoing below it rebuilds the base from the board
+        this->m_evalStack[0] = this->currentEvalState();
+        this->m_evalStack.top = 0;
+    }
+    EvalState& state = this->m_evalStack[++this->m_evalStack.top];
+    state.numDirty = 0;
+    state.computed = false;
+    state.needsRefresh = false;
+}
+
+void Board::markDirty(Square square, pieceTypes piece, bool added) {
+    if (!this->m_evalStack.isAllocated()) {
+        return;
+    }
+    EvalState& state = this->m_evalStack[this->m_evalStack.top];
+    state.computed = false;
+    // a piece placed and then replaced on the same square within one move cancels out
+    for (int i = 0; i < state.numDirty; ++i) {
+        const DirtyPiece& dirty = state.dirtyPieces[i];
+        if (dirty.square == square && dirty.piece == piece && dirty.added != added) {
+            state.dirtyPieces[i] = state.dirtyPieces[--state.numDirty];
+            return;
+        }
+    }
+    if (this->m_evalStack.top == 0 || state.numDirty == MAX_DIRTY_PIECES) {
+        state.needsRefresh = true;
+        return;
+    }
+    state.dirtyPieces[state.numDirty++] = {square, piece, added};
+}
+
+// brings the top state up to date by replaying dirty pieces from the closest computed state below it
+auto Board::currentEvalState() const -> const EvalState& {
+    if (!this->m_evalStack.isAllocated()) {
+        this->m_evalStack.reset();
+    }
+    EvalState& top = this->m_evalStack[this->m_evalStack.top];
+    if (top.computed) {
+        return top;
+    }
+
+    int base = this->m_evalStack.top;
+    while (!this->m_evalStack[base].computed) {
+        if (base == 0 || this->m_evalStack[base].needsRefresh) {
+            this->refreshEvalState(top);
+            return top;
+        }
+        --base;
+    }
+
+    const bool updateAccumulator = NNUE::isLoaded();
+    for (int i = base + 1; i <= this->m_evalStack.top; ++i) {
+        const EvalState& prev = this->m_evalStack[i - 1];
+        EvalState& state = this->m_evalStack[i];
+        state.info = prev.info;
+        if (updateAccumulator) {
+            state.accumulator = prev.accumulator;
+        }
+        for (int j = 0; j < state.numDirty; ++j) {
+            const DirtyPiece& dirty = state.dirtyPieces[j];
+            if (dirty.added) {
+                state.info.addPiece(dirty.square, dirty.piece);
+                if (updateAccumulator) {
+                    state.accumulator.addPiece(dirty.square, dirty.piece);
+                }
+            }
+            else {
+                state.info.removePiece(dirty.square, dirty.piece);
+                if (updateAccumulator) {
+                    state.accumulator.removePiece(dirty.square, dirty.piece);
+                }
+            }
+        }
+        state.computed = true;
+    }
+    return top;
+}
+
+void Board::refreshEvalState(EvalState& state) const {
+    const bool updateAccumulator = NNUE::isLoaded();
+    state.info = Eval::Info();
+    if (updateAccumulator) {
+        state.accumulator.reset();
+    }
+    for (Square square = 0; square < BOARD_SIZE; ++square) {
+        const pieceTypes piece = this->getPiece(square);
+        if (piece == EmptyPiece) {
+            continue;
+        }
+        state.info.addPiece(square, piece);
+        if (updateAccumulator) {
+            state.accumulator.addPiece(square, piece);
+        }
+    }
+    state.computed = true;
+    state.needsRefresh = false;
+}
+
+auto Board::isPseudoLegalMove(const Move move) const -> bool {
+    if (!move) {
+        return false;
+    }
+
+    const Square from = move.sqr1();
+    const Square to = move.sqr2();
+    const pieceTypes piece = this->getPiece(from);
+    if (piece == EmptyPiece || (piece < BKing) != this->m_isWhiteTurn) {
+        return false;
+    }
+    const uint64_t target = c_u64(1) << to;
+    if (target & this->pieceSets.get(ALL, this->m_isWhiteTurn)) {
+        return false;
+    }
+
+    const uint64_t allPieces = this->pieceSets.get(ALL);
+    const pieceTypes promotion = move.promotePiece();
+    const pieceTypes pieceType = static_cast<pieceTypes>(piece < BKing ? piece : piece - BKing);
+
+    if (pieceType == PAWN) {
+        // pawns reaching the last rank must promote to a piece of their own color
+        const bool reachesLastRank = target & (this->m_isWhiteTurn ? RANK_8 : RANK_1);
+        if (reachesLastRank != (promotion != EmptyPiece)) {
+            return false;
+        }
+        if (reachesLastRank && (promotion < BKing) != this->m_isWhiteTurn) {
+            return false;
+        }
+
+        const int forward = this->m_isWhiteTurn ? -8 : 8;
+        if (to == from + forward) {
+            return !(target & allPieces);
+        }
+        if (to == from + 2 * forward) {
+            const uint64_t startRank = this->m_isWhiteTurn ? RANK_2 : RANK_7;
+            const uint64_t path = target | (c_u64(1) << (from + forward));
+            return ((c_u64(1) << from) & startRank) && !(path & allPieces);
+        }
+        uint64_t enemies = this->pieceSets.get(ALL, !this->m_isWhiteTurn);
+        if (this->m_enPassSquare != NULLSQUARE) {
+            enemies |= c_u64(1) << this->m_enPassSquare;
+        }
+        return Attacks::pawnAttacks(from, this->m_isWhiteTurn) & target & enemies;
+    }
+    if (promotion != EmptyPiece) {
+        return false;
+    }
+
+    switch (pieceType) {
+        case KNIGHT:
+            return Attacks::knightAttacks(from) & target;
+        case BISHOP:
+            return Attacks::bishopAttacks(from, allPieces) & target;
+        case ROOK:
+            return Attacks::rookAttacks(from, allPieces) & target;
+        case QUEEN:
+            return (Attacks::bishopAttacks(from, allPieces) | Attacks::rookAttacks(from, allPieces)) & target;
+        default:
+            break;
+    }
+
+    // king
+    if (Attacks::kingAttacks(from) & target) {
+        return true;
+    }
+    const castleRights castle = castleRightsBit(to, this->m_isWhiteTurn);
+    if (!(castle & this->m_castlingRights) || from != (this->m_isWhiteTurn ? 60 : 4) || this->inCheck()) {
+        return false;
+    }
+    const int castleIndex = lsb(castle);
+    const uint64_t kingPath = (c_u64(1) << CASTLE_KING_PATHS[castleIndex]) | target;
+    return !(CASTLE_ROOK_PATHS[castleIndex] & allPieces) && !(kingPath & this->enemyAttacks());
+}
+
 auto Board::isLegalMove(const Move move) const -> bool {
     // This is a bitboard implementation to check whether a move leaves the ally king under attack
     // The current move generation already checks whether castling is even valid 
@@ -356,6 +572,20 @@ auto Board::isLegalMove(const Move move) const -> bool {
         return false;
     }
 
+    // apart from king moves and en passant, a move is legal if it doesn't break a pin or ignore a check
+    const pieceTypes movingPiece = this->getPiece(move.sqr1());
+    const bool isKingMove = movingPiece == WKing || movingPiece == BKing;
+    const bool isEnPassant = (movingPiece == WPawn || movingPiece == BPawn) && move.sqr2() == this->m_enPassSquare;
+    if (!isKingMove && !isEnPassant) {
+        const Square kingSquare = lsb(this->pieceSets.get(KING, this->m_isWhiteTurn));
+        const uint64_t target = c_u64(1) << move.sqr2();
+        const uint64_t checkers = this->checkers();
+        if (checkers && (popcount(checkers) > 1 || !((checkers | Attacks::between(kingSquare, lsb(checkers))) & target))) {
+            return false;
+        }
+        return !(this->pinned() & (c_u64(1) << move.sqr1())) || (Attacks::line(kingSquare, move.sqr1()) & target);
+    }
+
     PieceSets tmpPieceSets = this->pieceSets;
 
     const uint64_t originSquare = (c_u64(1) << move.sqr1());
@@ -402,19 +632,47 @@ auto Board::moveIsCapture(Move move) const -> bool {
     return this->getPiece(move.sqr2()) != EmptyPiece;
 }
 
-bool Board::isDraw() const {
+bool Board::isDraw(int searchPly) const {
     // fifty move rule
     if (this->m_fiftyMoveRule >= 100) {
         return true;
     }
-    // 3fold repetition
-    const int occurrences = std::count(this->m_zobristKeyHistory.begin(), this->m_zobristKeyHistory.end(), this->m_zobristKey);
-    return occurrences >= 3 ? true : false;
+    // repetitions; positions before the last irreversible move can't repeat
+    // and only positions with the same side to move are compared
+    const int lastIndex = static_cast<int>(this->m_zobristKeyHistory.size()) - 1;
+    const int window = std::min(this->m_fiftyMoveRule, lastIndex);
+    int repetitions = 0;
+    for (int pliesAgo = 4; pliesAgo <= window; pliesAgo += 2) {
+        if (this->m_zobristKeyHistory[lastIndex - pliesAgo] != this->m_zobristKey) {
+            continue;
+        }
+        // repeating a position reached after the search root is already a draw
+        if (pliesAgo < searchPly) {
+            return true;
+        }
+        // 3fold repetition
+        if (++repetitions == 2) {
+            return true;
+        }
+    }
+    return false;
 }
     
 // positive return values means winning for the side to move, negative is opposite
-auto Board::evaluate() -> int {
-    const int rawEval = this->eval.getRawEval(this->pieceSets, this->m_isWhiteTurn);
+auto Board::evaluate() const -> int {
+    const EvalState& state = this->currentEvalState();
+    if (NNUE::isLoaded()) {
+        return NNUE::evaluate(state.accumulator, this->m_isWhiteTurn);
+    }
+    const int rawEval = state.info.getRawEval(this->pieceSets, this->m_isWhiteTurn);
+    return this->m_isWhiteTurn ? rawEval : rawEval * -1;
+}
+auto Board::evaluate(Eval::PawnCache& pawnCache) const -> int {
+    const EvalState& state = this->currentEvalState();
+    if (NNUE::isLoaded()) {
+        return NNUE::evaluate(state.accumulator, this->m_isWhiteTurn);
+    }
+    const int rawEval = state.info.getRawEval(this->pieceSets, this->m_isWhiteTurn, pawnCache);
     return this->m_isWhiteTurn ? rawEval : rawEval * -1;
 }
 
@@ -477,6 +735,59 @@ auto castleRightsBit(Square finalKingPos, bool m_isWhiteTurn) -> castleRights {
     }
 }
 
+void Board::computeCheckInfo() const {
+    const uint64_t allPieces = this->pieceSets.get(ALL);
+    const uint64_t allies = this->pieceSets.get(ALL, this->m_isWhiteTurn);
+    const Square kingSquare = lsb(this->pieceSets.get(KING, this->m_isWhiteTurn));
+    const bool enemyColor = !this->m_isWhiteTurn;
+    const uint64_t enemyQueens = this->pieceSets.get(QUEEN, enemyColor);
+    const uint64_t enemyBishopsQueens = this->pieceSets.get(BISHOP, enemyColor) | enemyQueens;
+    const uint64_t enemyRooksQueens = this->pieceSets.get(ROOK, enemyColor) | enemyQueens;
+
+    this->m_checkers = (this->pieceSets.get(PAWN, enemyColor) & Attacks::pawnAttacks(kingSquare, this->m_isWhiteTurn))
+                     | (this->pieceSets.get(KNIGHT, enemyColor) & Attacks::knightAttacks(kingSquare))
+                     | (enemyBishopsQueens & Attacks::bishopAttacks(kingSquare, allPieces))
+                     | (enemyRooksQueens & Attacks::rookAttacks(kingSquare, allPieces));
+
+    // ally pieces that are the only blocker between the king and an enemy slider are pinned to that line
+    this->m_pinned = 0;
+    uint64_t snipers = (enemyBishopsQueens & Attacks::bishopAttacks(kingSquare, 0))
+                     | (enemyRooksQueens & Attacks::rookAttacks(kingSquare, 0));
+    while (snipers) {
+        const uint64_t blockers = Attacks::between(kingSquare, popLsb(snipers)) & allPieces;
+        if (popcount(blockers) == 1) {
+            this->m_pinned |= blockers & allies;
+        }
+    }
+    this->m_checkInfoValid = true;
+}
+
+void Board::computeEnemyAttacks() const {
+    const bool enemyColor = !this->m_isWhiteTurn;
+    const uint64_t occupancy = this->pieceSets.get(ALL) ^ this->pieceSets.get(KING, this->m_isWhiteTurn);
+    const uint64_t enemyQueens = this->pieceSets.get(QUEEN, enemyColor);
+
+    uint64_t attacks = Attacks::kingAttacks(lsb(this->pieceSets.get(KING, enemyColor)));
+    uint64_t pieces = this->pieceSets.get(PAWN, enemyColor);
+    while (pieces) {
+        attacks |= Attacks::pawnAttacks(popLsb(pieces), enemyColor);
+    }
+    pieces = this->pieceSets.get(KNIGHT, enemyColor);
+    while (pieces) {
+        attacks |= Attacks::knightAttacks(popLsb(pieces));
+    }
+    pieces = this->pieceSets.get(BISHOP, enemyColor) | enemyQueens;
+    while (pieces) {
+        attacks |= Attacks::bishopAttacks(popLsb(pieces), occupancy);
+    }
+    pieces = this->pieceSets.get(ROOK, enemyColor) | enemyQueens;
+    while (pieces) {
+        attacks |= Attacks::rookAttacks(popLsb(pieces), occupancy);
+    }
+    this->m_enemyAttacks = attacks;
+    this->m_enemyAttacksValid = true;
+}
+
 auto currKingInAttack(const PieceSets& pieceSets, bool isWhiteTurn) -> bool {
     const uint64_t allyKing = pieceSets.get(KING, isWhiteTurn);
     assert(allyKing);
@@ -20,15 +20,23 @@
 #pragma once
 
 #include <array>
-#include <vector>
+#include <memory>
 
 #include "eval.hpp"
+#include "nnue.hpp"
 #include "pieceSets.hpp"
 #include "move.hpp"
 #include "bitboard.hpp"
+#include "utils/fixedVector.hpp"
 #include "utils/types.hpp"
 
+// plies of game history a board can hold on top of a search; uci positions clear their history
+// after irreversible moves so real games stay well below this, and longer ones drop their oldest half
+inline constexpr int MAX_GAME_PLY = 1024;
+inline constexpr int MAX_HISTORY = MAX_GAME_PLY + MAX_PLY;
+
 struct BoardState {
+    BoardState() = default;
     BoardState(Move a_move, pieceTypes a_originPiece, pieceTypes a_targetPiece, castleRights a_castlingRights, Square a_enPassSquare, int a_fiftyMoveRule) :
                 move(a_move), 
                 originPiece(a_originPiece), 
@@ -44,6 +52,63 @@ struct BoardState {
     int fiftyMoveRule;
 };
 
+// a piece added to or removed from a square by a move
+struct DirtyPiece {
+    Square square;
+    pieceTypes piece;
+    bool added;
+};
+
+// castling is the most pieces a move changes once a piece moved onto and off the same square cancels out
+inline constexpr int MAX_DIRTY_PIECES = 4;
+// deep enough for a full search on top of the reversible moves of a game; older states get folded into the base
+inline constexpr int EVAL_STACK_SIZE = MAX_PLY + 1;
+
+// evaluation state of one ply; each state is derived from the one below it and its dirty pieces,
+// but only once the position is actually evaluated
+struct EvalState {
+    Eval::Info info;
+    NNUE::Accumulator accumulator;
+    std::array<DirtyPiece, MAX_DIRTY_PIECES> dirtyPieces;
+    int numDirty;
+    bool computed;
+    // set when the dirty pieces can't describe the change, so the state has to be rebuilt from the board
+    bool needsRefresh;
+};
+
+// owns the eval states on the heap, which is only allocated once the board is evaluated; copies don't
+// take the states along, so copying a board stays cheap and the copy rebuilds its state lazily
+class EvalStack {
+    public:
+        EvalStack() = default;
+        EvalStack(const EvalStack&) {};
+        EvalStack& operator=(const EvalStack&) {
+            if (this->isAllocated()) {
+                this->reset();
+            }
+            return *this;
+        };
+        EvalStack(EvalStack&&) = default;
+        EvalStack& operator=(EvalStack&&) = default;
+
+        EvalState& operator[](int index) {return (*this->states)[index];};
+        auto isAllocated() const -> bool {return this->states != nullptr;};
+        // allocates the states if needed and leaves only a base that is rebuilt from the board
+        void reset() {
+            if (!this->states) {
+                this->states = std::make_unique<std::array<EvalState, EVAL_STACK_SIZE>>();
+            }
+            this->top = 0;
+            (*this->states)[0].numDirty = 0;
+            (*this->states)[0].computed = false;
+            (*this->states)[0].needsRefresh = true;
+        };
+
+        int top = 0;
+    private:
+        std::unique_ptr<std::array<EvalState, EVAL_STACK_SIZE>> states;
+};
+
 class Board {
     public:
         Board(std::string fenStr);
@@ -58,10 +123,14 @@ class Board {
         auto getPiece(Square square) const -> pieceTypes;
         void setPiece(Square square, pieceTypes currPiece);
 
+        // whether move could have been generated in this position, ignoring whether the king is left in check
+        auto isPseudoLegalMove(const Move move) const -> bool;
         auto isLegalMove(const Move move) const -> bool;
         auto moveIsCapture(Move move) const -> bool;
-        auto isDraw() const -> bool;
-        auto evaluate() -> int;
+        // searchPly is the distance from the search root; repetitions within the search count as draws
+        auto isDraw(int searchPly = 0) const -> bool;
+        auto evaluate() const -> int;
+        auto evaluate(Eval::PawnCache& pawnCache) const -> int;
         auto lastMoveCaptureOrCastle() const -> bool;
         void clearHistory();
         auto hasNonPawnMat() const -> bool;
@@ -74,25 +143,55 @@ class Board {
         auto fiftyMoveRule() const -> int;
         auto zobristKey() const -> uint64_t;
 
+        // check information is computed at most once per position and cached until the position changes
+        auto checkers() const -> uint64_t;
+        auto pinned() const -> uint64_t;
+        auto inCheck() const -> bool;
+        // squares attacked by the enemy; sliders see through the ally king so it can't step along their lines
+        auto enemyAttacks() const -> uint64_t;
+
         auto operator==(const Board& rhs) const -> bool;
         friend auto operator<<(std::ostream& os, const Board& obj) -> std::ostream&;
 
         PieceSets pieceSets{};
     private:
         void initZobristKey();
+        // updates the board without recording the change for evaluation
+        void placePiece(Square square, pieceTypes currPiece);
+        void reserveHistory();
+        void pushEvalState();
+        void markDirty(Square square, pieceTypes piece, bool added);
+        auto currentEvalState() const -> const EvalState&;
+        void refreshEvalState(EvalState& state) const;
+        void computeCheckInfo() const;
+        void computeEnemyAttacks() const;
+        void invalidateCheckInfo();
 
         std::array<pieceTypes, BOARD_SIZE> m_board;
-        Eval::Info eval;
+        // accumulators are only updated while a network is loaded
+        mutable EvalStack m_evalStack;
 
         bool m_isWhiteTurn;
         castleRights m_castlingRights;
         Square m_enPassSquare;
         int m_fiftyMoveRule;
         uint64_t m_zobristKey; // zobristKeyHistory also contains zobristKey
-        std::vector<uint64_t> m_zobristKeyHistory;
-        std::vector<BoardState> m_moveHistory;
+        // fixed capacity so make/undo never allocate; copies only touch the used entries
+        FixedVector<uint64_t, MAX_HISTORY + 1> m_zobristKeyHistory;
+        FixedVector<BoardState, MAX_HISTORY> m_moveHistory;
+
+        // lazily computed caches of the current position
+        mutable uint64_t m_checkers{};
+        mutable uint64_t m_pinned{};
+        mutable uint64_t m_enemyAttacks{};
+        mutable bool m_checkInfoValid{};
+        mutable bool m_enemyAttacksValid{};
 };
 
+// boards are copied by value for searchers, perft tasks and uci commands, so large per-ply state has to live
+// outside of them like the eval stack does; the history is the bulk of this
+static_assert(sizeof(Board) <= 48 * 1024);
+
 inline auto Board::hasNonPawnMat() const -> bool {
     const auto pieces = this->pieceSets.get(ALL);
     const auto pawns = this->pieceSets.get(PAWN);
@@ -124,5 +223,41 @@ inline auto Board::zobristKey() const -> uint64_t {
     return this->m_zobristKey;
 }
 
+inline auto Board::checkers() const -> uint64_t {
+    if (!this->m_checkInfoValid) {
+        this->computeCheckInfo();
+    }
+    return this->m_checkers;
+}
+
+inline auto Board::pinned() const -> uint64_t {
+    if (!this->m_checkInfoValid) {
+        this->computeCheckInfo();
+    }
+    return this->m_pinned;
+}
+
+inline auto Board::inCheck() const -> bool {
+    return this->checkers() != 0;
+}
+
+inline auto Board::enemyAttacks() const -> uint64_t {
+    if (!this->m_enemyAttacksValid) {
+        this->computeEnemyAttacks();
+    }
+    return this->m_enemyAttacks;
+}
+
+inline void Board::invalidateCheckInfo() {
+    this->m_checkInfoValid = false;
+    this->m_enemyAttacksValid = false;
+}
+
+// indexes based on castle rights defined in "types.hpp"
+inline constexpr std::array<uint64_t, 4> CASTLE_ROOK_PATHS = {
+    0x6000000000000000, 0x0E00000000000000, 0x0000000000000060, 0x000000000000000E};
+inline constexpr std::array<Square, 4> CASTLE_KING_PATHS = {61, 59, 5, 3};
+inline constexpr std::array<Square, 4> CASTLE_DESTINATIONS = {62, 58, 6, 2};
+
 auto castleRightsBit(Square finalKingPos, bool isWhiteTurn) -> castleRights;
 auto currKingInAttack(const PieceSets& pieceSets, bool isWhiteTurn) -> bool;
\ No newline at end of file
@@ -16,6 +16,7 @@
 * if not, see <https://www.gnu.org/licenses>.
 */
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <iostream>
@@ -30,9 +31,18 @@
 
 namespace Eval {
 
-int Info::getRawEval(const PieceSets& pieceSets, bool isWhiteTurn) {
+int Info::getRawEval(const PieceSets& pieceSets, bool isWhiteTurn) const {
+    const S pawnScore = evalPawns(pieceSets, true) - evalPawns(pieceSets, false);
+    return this->blendScores(pieceSets, isWhiteTurn, pawnScore);
+}
+
+int Info::getRawEval(const PieceSets& pieceSets, bool isWhiteTurn, PawnCache& pawnCache) const {
+    const S pawnScore = pawnCache.probe(pieceSets, this->pawnKey).score;
+    return this->blendScores(pieceSets, isWhiteTurn, pawnScore);
+}
+
+int Info::blendScores(const PieceSets& pieceSets, bool isWhiteTurn, S pawnScore) const {
     // positive values means white is winning, negative means black
-    const S pawnScore = this->getPawnInfo(pieceSets).score;
     const S pieceScore = evalPieces(pieceSets, true) - evalPieces(pieceSets, false);
     const S totalScore = this->score + pawnScore + pieceScore;
 
@@ -60,15 +70,31 @@ void Info::removePiece(Square square, pieceTypes piece) {
     }
 }
 
-const PawnHashEntry& Info::getPawnInfo(const PieceSets& pieceSets) {
+void PawnCache::resize(uint64_t sizeMb) {
+    sizeMb = std::clamp(sizeMb, MIN_PAWN_HASH_MB, MAX_PAWN_HASH_MB);
+    this->table = std::vector<PawnHashEntry>(sizeMb * 1024 * 1024 / sizeof(PawnHashEntry));
+    this->clear();
+}
+
+void PawnCache::clear() {
+    std::fill(this->table.begin(), this->table.end(), PawnHashEntry());
+    this->hits = 0;
+    this->probes = 0;
+}
+
+const PawnHashEntry& PawnCache::probe(const PieceSets& pieceSets, uint64_t pawnKey) {
     // probe pawn hash table for precomputed values
     // if not found, then compute the pawn values and replace the entry
-    PawnHashEntry& entry = this->pawnHashTable[this->pawnKey % PAWN_HASH_SIZE];
-    if (this->pawnKey != entry.key) {
+    PawnHashEntry& entry = this->table[pawnKey % this->table.size()];
+    this->probes++;
+    if (pawnKey != entry.key) {
         entry.score = S();
         entry.score += evalPawns(pieceSets, true);
         entry.score -= evalPawns(pieceSets, false);
-        entry.key = this->pawnKey;
+        entry.key = pawnKey;
+    }
+    else {
+        this->hits++;
     }
     return entry;
 }
@@ -150,6 +176,11 @@ int getPiecePhase(pieceTypes piece) {
     }
 }
 
+// black pieces share the bound of their white counterpart
+int getMaxPieceValue(pieceTypes piece) {
+    return maxPieceValues[piece >= BKing ? piece - BKing : piece];
+}
+
 // assumes that currPiece is not empty
 S getPSQTVal(Square square, pieceTypes currPiece) {
     if (currPiece >= WKing && currPiece <= WPawn) {
@@ -18,6 +18,11 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
 #include "pieceSets.hpp"
 #include "move.hpp"
 #include "bitboard.hpp"
@@ -26,7 +31,9 @@
 namespace Eval {
 
 inline constexpr int TOTAL_PHASE = 24;
-inline constexpr int PAWN_HASH_SIZE = 1024;
+inline constexpr uint64_t DEFAULT_PAWN_HASH_MB = 1;
+inline constexpr uint64_t MIN_PAWN_HASH_MB = 1;
+inline constexpr uint64_t MAX_PAWN_HASH_MB = 256;
 
 // evaluation scores
 // contain both midgame and endgame scores
@@ -74,18 +81,36 @@ struct PawnHashEntry {
     uint64_t key{};
 };
 
+// caches pawn structure scores by pawn key
+// owned by each search thread instead of the board so board copies stay cheap
+class PawnCache {
+    public:
+        PawnCache(uint64_t sizeMb = DEFAULT_PAWN_HASH_MB) {this->resize(sizeMb);};
+        void resize(uint64_t sizeMb);
+        void clear();
+        const PawnHashEntry& probe(const PieceSets& pieceSets, uint64_t pawnKey);
+
+        uint64_t getHits() const {return this->hits;};
+        uint64_t getProbes() const {return this->probes;};
+    private:
+        std::vector<PawnHashEntry> table;
+        uint64_t hits{};
+        uint64_t probes{};
+};
+
 class Info {
     public:
         Info() = default;
-        int getRawEval(const PieceSets& pieceSets, bool isWhiteTurn);
+        // computes the pawn structure from scratch; used by tools without a pawn cache
+        int getRawEval(const PieceSets& pieceSets, bool isWhiteTurn) const;
+        int getRawEval(const PieceSets& pieceSets, bool isWhiteTurn, PawnCache& pawnCache) const;
         void addPiece(Square square, pieceTypes piece);
         void removePiece(Square square, pieceTypes piece);
     private:
-        const PawnHashEntry& getPawnInfo(const PieceSets& pieceSets);
+        int blendScores(const PieceSets& pieceSets, bool isWhiteTurn, S pawnScore) const;
 
         S score{};
         int phase{};
-        std::array<PawnHashEntry, PAWN_HASH_SIZE> pawnHashTable{};
         uint64_t pawnKey{};
 };
 
@@ -108,6 +133,9 @@ inline bool isBishopPair(uint64_t allyBishops) {
     return popcount(allyBishops) > 1;
 }
 
+// the most a piece is worth on any square in either phase; an optimistic bound on the gain of capturing it
+int getMaxPieceValue(pieceTypes piece);
+
 /*************
  * Evaluation Terms
 **************/
@@ -219,4 +247,15 @@ inline constexpr auto PSQT = [] {
     return tables;
 }();
 
+// the piece values are folded into the PSQT, so a piece can be worth far more than pieceVals on its best squares
+inline constexpr auto maxPieceValues = [] {
+    std::array<int, NUM_PIECES> values{};
+    for (int piece = 0; piece < NUM_PIECES; ++piece) {
+        for (const auto& sqr: PSQT[piece]) {
+            values[piece] = std::max({values[piece], sqr.opScore, sqr.egScore});
+        }
+    }
+    return values;
+}();
+
 } // namespace eval
\ No newline at end of file
@@ -32,6 +32,10 @@ class Move {
         Move(std::string input, bool isWhiteTurn);
         std::string toStr() const;
 
+        // raw 16 bit encoding, used to pack moves together with other data
+        uint16_t getData() const {return this->data;};
+        static Move fromData(uint16_t a_data) {Move move; move.data = a_data; return move;};
+
         Square sqr1() const;
         Square sqr2() const;
         pieceTypes promotePiece() const;
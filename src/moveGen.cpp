@@ -40,6 +40,21 @@ MoveList::MoveList(const Board& board) {
     this->pawns   = board.pieceSets.get(PAWN, board.isWhiteTurn());
     this->promotingPawns = board.isWhiteTurn() ? this->pawns & RANK_7 : this->pawns & RANK_2;
     this->pawns ^= promotingPawns;
+
+    // check and pin information is shared with the search through the board's cache
+    this->kingSquare = lsb(this->kings);
+    this->checkers = board.checkers();
+    this->pinned = board.pinned();
+    this->enemyAttacks = board.enemyAttacks();
+
+    // pieces checking the king can only be captured or blocked; double checks require the king to move
+    if (!this->checkers) {
+        this->checkMask = ALL_SQUARES;
+    } else if (popcount(this->checkers) == 1) {
+        this->checkMask = this->checkers | Attacks::between(this->kingSquare, lsb(this->checkers));
+    } else {
+        this->checkMask = NO_SQUARES;
+    }
 }
 
 void MoveList::generateAllMoves(const Board& board) {
@@ -51,11 +66,11 @@ void MoveList::generateCaptures(const Board& board) {
     // helper information for captures
     uint64_t validDests = board.pieceSets.get(ALL, !isWhiteTurn);
     this->enPassSquare = board.enPassSquare();
+    this->enPassBB = this->enPassSquare != NULLSQUARE ? c_u64(1) << this->enPassSquare : NO_SQUARES;
 
     const auto knightMovesFunc = [this](Square piece, uint64_t vd) {return this->knightMoves(piece, vd);};
     const auto bishopMovesFunc = [this](Square piece, uint64_t vd) {return this->bishopMoves(piece, vd);};
     const auto rookMovesFunc = [this](Square piece, uint64_t vd) {return this->rookMoves(piece, vd);};
-    const auto kingMovesFunc = [this](Square piece, uint64_t vd) {return this->kingMoves(piece, vd);};
     const auto pawnCapturesFunc = [this](Square piece, uint64_t vd) {return this->pawnCaptures(piece, vd);};
     const auto pawnPushesFunc = [this](Square piece, uint64_t vd) {return this->pawnPushes(piece, vd);};
 
@@ -65,12 +80,10 @@ void MoveList::generateCaptures(const Board& board) {
     this->generatePieceMoves(this->rooks, validDests, rookMovesFunc, board);
     this->generatePieceMoves(this->queens, validDests, bishopMovesFunc, board);
     this->generatePieceMoves(this->queens, validDests, rookMovesFunc, board);
-    this->generatePieceMoves(this->kings, validDests, kingMovesFunc, board);
+    this->generateKingMoves(validDests);
 
     // non-promotion pawn captures including en passant
-    if (this->enPassSquare != NULLSQUARE) {
-        validDests |= c_u64(1) << this->enPassSquare;
-    }
+    validDests |= this->enPassBB;
     this->generatePieceMoves(pawns, validDests, pawnCapturesFunc, board);
 
     // pawn captures promotions
@@ -92,7 +105,6 @@ void MoveList::generateQuiets(const Board& board) {
     const auto knightMovesFunc = [this](Square piece, uint64_t vd) {return this->knightMoves(piece, vd);};
     const auto bishopMovesFunc = [this](Square piece, uint64_t vd) {return this->bishopMoves(piece, vd);};
     const auto rookMovesFunc = [this](Square piece, uint64_t vd) {return this->rookMoves(piece, vd);};
-    const auto kingMovesFunc = [this](Square piece, uint64_t vd) {return this->kingMoves(piece, vd);};
     const auto pawnPushesFunc = [this](Square piece, uint64_t vd) {return this->pawnPushes(piece, vd);};
 
     // regular quiets
@@ -102,10 +114,10 @@ void MoveList::generateQuiets(const Board& board) {
     this->generatePieceMoves(this->rooks, validDests, rookMovesFunc, board);
     this->generatePieceMoves(this->queens, validDests, bishopMovesFunc, board);
     this->generatePieceMoves(this->queens, validDests, rookMovesFunc, board);
-    this->generatePieceMoves(this->kings, validDests, kingMovesFunc, board);
+    this->generateKingMoves(validDests);
 
     // castling
-    this->generateKingCastles(board);
+    this->generateKingCastles();
 
     // non-queen promotions
     this->generatePawnPromotions(this->promotingPawns, this->emptySquares, pawnPushesFunc, board, false);
@@ -117,13 +129,20 @@ void MoveList::generatePieceMoves(uint64_t pieces, uint64_t validDests, Func pie
         const Square piece = popLsb(pieces);
         uint64_t dests = pieceMoves(piece, validDests);
 
-        while (dests) {
-            const int target = popLsb(dests);
-            const Move move(piece, target);
+        // en passant removes two pieces from the board, which the pin and check masks can't account for
+        if (dests & this->enPassBB) {
+            dests ^= this->enPassBB;
+            const Move move(piece, this->enPassSquare);
             if (board.isLegalMove(move)) {
                 this->moves.push_back(move);
             }
         }
+
+        dests &= this->legalDests(piece);
+        while (dests) {
+            const int target = popLsb(dests);
+            this->moves.push_back(Move(piece, target));
+        }
     }
 }
 
@@ -136,15 +155,10 @@ void MoveList::generatePawnPromotions(uint64_t pieces, uint64_t validDests, Func
 
     while (pieces) {
         const Square piece = popLsb(pieces);
-        uint64_t dests = pieceMoves(piece, validDests);
+        uint64_t dests = pieceMoves(piece, validDests) & this->legalDests(piece);
 
         while (dests) {
             const int target = popLsb(dests);
-            const Move move(piece, target);
-            if (!board.isLegalMove(move)) {
-                continue;
-            }
-
             if (QUEENS) {
                 this->moves.push_back(Move(piece, target, allyQueen));
             } else {
@@ -156,17 +170,27 @@ void MoveList::generatePawnPromotions(uint64_t pieces, uint64_t validDests, Func
     }
 }
 
-void MoveList::generateKingCastles(const Board& board) {
-    // assumes one king
-    const Square king = lsb(this->kings);
-    uint64_t dests = this->kingCastles(board.pieceSets);
+void MoveList::generateKingMoves(uint64_t validDests) {
+    uint64_t dests = this->kingMoves(this->kingSquare, validDests & ~this->enemyAttacks);
+    while (dests) {
+        this->moves.push_back(Move(this->kingSquare, popLsb(dests)));
+    }
+}
+
+void MoveList::generateKingCastles() {
+    uint64_t dests = this->kingCastles();
     while (dests) {
         const int target = popLsb(dests);
-        const Move move(king, target);
-        if (board.isLegalMove(move)) {
-            this->moves.push_back(move);
-        }
+        this->moves.push_back(Move(this->kingSquare, target));
+    }
+}
+
+// non-king pieces may only resolve checks and may only move along the line they are pinned to
+uint64_t MoveList::legalDests(Square piece) const {
+    if (this->pinned & (c_u64(1) << piece)) {
+        return this->checkMask & Attacks::line(this->kingSquare, piece);
     }
+    return this->checkMask;
 }
 
 uint64_t MoveList::knightMoves(int square, uint64_t validDests) const {
@@ -207,36 +231,26 @@ uint64_t MoveList::pawnPushes(int square, uint64_t validDests) const {
     return dests;
 }
 
-uint64_t MoveList::kingCastles(PieceSets pieceSets) {
-    // indexes based on castle rights defined in "types.hpp"
-    constexpr std::array<uint64_t, 4> rookPaths = {
-        0x6000000000000000, 0x0E00000000000000, 0x0000000000000060, 0x000000000000000E};
-    constexpr std::array<uint64_t, 4> kingPaths = {
-        0x2000000000000000, 0x0800000000000000, 0x0000000000000020, 0x0000000000000008};
-    constexpr std::array<uint64_t, 4> castleDestination = {
-        0x4000000000000000, 0x0400000000000000, 0x0000000000000040, 0x0000000000000004};
-
+uint64_t MoveList::kingCastles() {
     uint64_t dests{};
-    // test if the king is in check; castling is illegal in check
-    if (!currKingInAttack(pieceSets, this->isWhiteTurn)) {
-        const int kingIndex = this->isWhiteTurn ? WKing : BKing;
-
+    // castling is illegal in check
+    if (!this->checkers) {
         while (this->castlingRights) {
             const int currRight = popLsb(this->castlingRights);
 
             // check for emptiness between rook and king
-            if (rookPaths[currRight] & this->allPieces) {
+            if (CASTLE_ROOK_PATHS[currRight] & this->allPieces) {
                 continue;
             }
 
-            // check for king path being attacked
-            pieceSets[kingIndex] = kingPaths[currRight];
-            if (currKingInAttack(pieceSets, this->isWhiteTurn)) {
+            // the king can't pass through or land on an attacked square
+            const uint64_t kingPath = (c_u64(1) << CASTLE_KING_PATHS[currRight]) | (c_u64(1) << CASTLE_DESTINATIONS[currRight]);
+            if (kingPath & this->enemyAttacks) {
                 continue;
             }
 
             // perform castle
-            dests |= castleDestination[currRight];
+            dests |= c_u64(1) << CASTLE_DESTINATIONS[currRight];
         }
     }
 
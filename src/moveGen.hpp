@@ -39,7 +39,10 @@ class MoveList {
         void generatePieceMoves(uint64_t pieces, uint64_t validDests, Func pieceMoves, const Board& board);
         template<typename Func>
         void generatePawnPromotions(uint64_t pieces, uint64_t validDests, Func pieceMoves, const Board& board, const bool QUEENS);
-        void generateKingCastles(const Board& board);
+        void generateKingMoves(uint64_t validDests);
+        void generateKingCastles();
+
+        uint64_t legalDests(Square piece) const;
 
         uint64_t knightMoves(int square, uint64_t validDests) const;
         uint64_t bishopMoves(int square, uint64_t validDests) const;
@@ -47,14 +50,18 @@ class MoveList {
         uint64_t kingMoves(int square, uint64_t validDests) const;
         uint64_t pawnCaptures(int square, uint64_t validDests) const;
         uint64_t pawnPushes(int square, uint64_t validDests) const;
-        uint64_t kingCastles(PieceSets pieceSets);
+        uint64_t kingCastles();
 
         // used by both captures and quiets
         uint64_t pawns{}, promotingPawns{}, bishops{}, knights{}, rooks{}, queens{}, kings{};
         uint64_t allPieces{}, emptySquares{};
         bool isWhiteTurn{};
+        // legality information, computed once so that only king moves and en passant need to be validated
+        Square kingSquare{};
+        uint64_t checkers{}, checkMask{}, pinned{}, enemyAttacks{};
         // used by captures
         Square enPassSquare{};
+        uint64_t enPassBB{};
         // used by quiets
         uint64_t pawnStartRank{}, pawnJumpRank{};
         uint64_t castlingRights{};
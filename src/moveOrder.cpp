@@ -23,97 +23,224 @@
 #include "moveOrder.hpp"
 #include "board.hpp"
 #include "move.hpp"
+#include "see.hpp"
 
 namespace MoveOrder {
 
-MovePicker::MovePicker(const Board& board, const HistoryTable& history, Stage a_stage, Move a_TTMove, Move a_killerMove) {
-    this->moveList = MoveList(board);
-    this->moveScores = std::array<int, MAX_MOVES>{};
+MovePicker::MovePicker(Stage a_stage, Move a_TTMove, Move a_killerMove, Move a_counterMove, ContinuationPointers a_contHist) {
+    this->stage = a_stage;
+    this->phase = Phase::TTMove;
+    this->pickedPhase = Phase::TTMove;
     this->TTMove = a_TTMove;
     this->killerMove = a_killerMove;
+    this->counterMove = a_counterMove;
+    this->contHist = a_contHist;
+    this->nextIsQuiet = false;
+    this->current = this->capturesEnd = this->badCapturesEnd = 0;
     this->movesPicked = 0;
+}
 
-    if (board.moveIsCapture(this->TTMove)) {
-        this->moveList.generateCaptures(board);
-        this->assignMoveScores<true, Stage::Captures>(board, history);
-        this->stage = a_stage & Stage::Quiets;
-    } 
-    else if (a_stage == Stage::Captures){
-        this->moveList.generateCaptures(board);
-        this->assignMoveScores<false, Stage::Captures>(board, history);
-        this->stage = Stage::None;
-    }
-    else {
-        this->moveList.generateCaptures(board);
-        this->moveList.generateQuiets(board);
-        this->assignMoveScores<true, Stage::All>(board, history);
-        this->stage = Stage::None;
+// Searching moves that are likely to be better helps with pruning in search. This is move ordering.
+// Each stage is only generated once the previous one runs out, so nodes that cut early skip the rest.
+bool MovePicker::movesLeft(const Board& board, const Histories& histories) {
+    const bool wantsQuiets = this->stage & Stage::Quiets;
+    while (true) {
+        switch (this->phase) {
+            case Phase::TTMove: {
+                this->phase = Phase::GenerateCaptures;
+                // tt moves can come from hash collisions, so they are validated before being searched
+                // queen promotions count as captures here, just like generateCaptures hands them out with the captures
+                const bool isNoisy = board.moveIsCapture(this->TTMove);
+                if ((wantsQuiets || isNoisy)
+                    && board.isPseudoLegalMove(this->TTMove)
+                    && board.isLegalMove(this->TTMove)) {
+                    return this->setNextMove(this->TTMove, Phase::TTMove, !isNoisy);
+                }
+                this->TTMove = Move();
+                break;
+            }
+            case Phase::GenerateCaptures:
+                this->moveList = MoveList(board);
+                this->moveList.generateCaptures(board);
+                this->capturesEnd = this->moveList.moves.size();
+                this->scoreCaptures(board, histories);
+                this->phase = Phase::GoodCaptures;
+                break;
+            case Phase::GoodCaptures:
+                while (this->current < this->capturesEnd) {
+                    const Move move = this->selectBest(this->current++, this->capturesEnd);
+                    if (move == this->TTMove) {
+                        continue;
+                    }
+                    // slots before current are already used up, so losing captures are kept there for later
+                    if (!SEE::isAtLeast(board, move, 0)) {
+                        this->entries[this->badCapturesEnd++] = packEntry(move, 0);
+                        continue;
+                    }
+                    return this->setNextMove(move, Phase::GoodCaptures, false);
+                }
+                this->phase = wantsQuiets ? Phase::Killer : Phase::BadCaptures;
+                this->current = 0;
+                break;
+            case Phase::Killer:
+                this->phase = Phase::CounterMove;
+                if (this->killerMove != this->TTMove
+                    && !board.moveIsCapture(this->killerMove)
+                    && board.isPseudoLegalMove(this->killerMove)
+                    && board.isLegalMove(this->killerMove)) {
+                    return this->setNextMove(this->killerMove, Phase::Killer, true);
+                }
+                this->killerMove = Move();
+                break;
+            case Phase::CounterMove:
+                this->phase = Phase::GenerateQuiets;
+                if (this->counterMove != this->TTMove
+                    && this->counterMove != this->killerMove
+                    && !board.moveIsCapture(this->counterMove)
+                    && board.isPseudoLegalMove(this->counterMove)
+                    && board.isLegalMove(this->counterMove)) {
+                    return this->setNextMove(this->counterMove, Phase::CounterMove, true);
+                }
+                this->counterMove = Move();
+                break;
+            case Phase::GenerateQuiets:
+                this->moveList.generateQuiets(board);
+                this->scoreQuiets(board, histories);
+                this->current = this->capturesEnd;
+                this->phase = Phase::Quiets;
+                break;
+            case Phase::Quiets:
+                while (this->current < this->moveList.moves.size()) {
+                    const Move move = this->selectBest(this->current++, this->moveList.moves.size());
+                    if (move == this->TTMove || move == this->killerMove || move == this->counterMove) {
+                        continue;
+                    }
+                    return this->setNextMove(move, Phase::Quiets, true);
+                }
+                this->phase = Phase::BadCaptures;
+                this->current = 0;
+                break;
+            case Phase::BadCaptures:
+                if (this->current < this->badCapturesEnd) {
+                    return this->setNextMove(unpackMove(this->entries[this->current++]), Phase::BadCaptures, false);
+                }
+                this->phase = Phase::Done;
+                break;
+            case Phase::Done:
+                return false;
+        }
     }
 }
 
-// Searching moves that are likely to be better helps with pruning in search. This is move ordering.
-// More promising moves are given higher scores and then searched first.
-template<bool ASSIGN_TTMOVE, Stage STAGE>
-void MovePicker::assignMoveScores(const Board& board, const HistoryTable& history) {
-    constexpr bool ASSIGN_CAPTURES = STAGE & Stage::Captures;
+bool MovePicker::setNextMove(Move move, Phase pickedFrom, bool isQuiet) {
+    this->nextMove = move;
+    this->pickedPhase = pickedFrom;
+    this->nextIsQuiet = isQuiet;
+    return true;
+}
 
-    for (size_t i = this->movesPicked; i < this->moveList.moves.size(); ++i) {
+// Captures are scored by MVV-LVA with capture history breaking ties between similar victims
+// history is scaled to within half of the smallest gap between victim values, so it never outranks a better victim
+// whether they lose material is only checked by SEE once they are picked
+void MovePicker::scoreCaptures(const Board& board, const Histories& histories) {
+    for (size_t i = 0; i < this->capturesEnd; ++i) {
         const auto move = this->moveList.moves[i];
-        // Transposition Table Move, or PV Move
-        if (ASSIGN_TTMOVE && move == this->TTMove) {
-            this->moveScores[i] = MoveScores::PV;
-        }
-        // Captures
-        else if (ASSIGN_CAPTURES && board.moveIsCapture(move)) {
-            // Score using MVV-LVA
-            const int victimValue = this->getVictimScore(board, move) << 8;
-            const int attackerValue = pieceValues[board.getPiece(move.sqr1())];
-            this->moveScores[i] = MoveScores::Capture + victimValue - attackerValue;
-        }
-        // Killer Moves
-        else if (move == this->killerMove) {
-            this->moveScores[i] = MoveScores::Killer;
-        }
-        // Quiet Moves, ordered by history
-        else {
-            this->moveScores[i] = MoveScores::Quiet + history[move.sqr1()][move.sqr2()];
-        }
+        const pieceTypes attacker = board.getPiece(move.sqr1());
+        const int victimValue = this->getVictimScore(board, move) << 8;
+        const int captureHistory = histories.capture[attacker][move.sqr2()][captureVictimType(board, move)];
+        this->entries[i] = packEntry(move, victimValue - pieceValues[attacker] + captureHistory / 64);
     }
 }
 
-bool MovePicker::movesLeft(const Board& board, const HistoryTable& history) {
-    // check if an additional quiet stage needs to be generated
-    if (this->movesPicked >= this->moveList.moves.size() && this->stage == Stage::Quiets) {
-        this->moveList.generateQuiets(board);
-        this->assignMoveScores<false, Stage::Quiets>(board, history);
-        this->stage = Stage::None;
+// Quiet moves are ordered by butterfly history plus the continuation histories of the last two moves
+void MovePicker::scoreQuiets(const Board& board, const Histories& histories) {
+    for (size_t i = this->capturesEnd; i < this->moveList.moves.size(); ++i) {
+        const auto move = this->moveList.moves[i];
+        const pieceTypes piece = board.getPiece(move.sqr1());
+        int score = histories.butterfly[move.sqr1()][move.sqr2()];
+        for (const PieceToHistory* continuation: this->contHist) {
+            if (continuation != nullptr) {
+                score += (*continuation)[piece][move.sqr2()];
+            }
+        }
+        this->entries[i] = packEntry(move, score);
     }
-    return this->movesPicked < this->moveList.moves.size();
 }
 
-int MovePicker::getMovesPicked() const {
-    return this->movesPicked;
+// Due to pruning, we don't need to sort the entire array of moves for move ordering.
+// Selecting the best remaining move each time only pays for the moves that are actually searched.
+Move MovePicker::selectBest(size_t begin, size_t end) {
+    return unpackMove(selectMaxEntry(this->entries.data(), begin, end));
 }
 
-bool MovePicker::stagesLeft() const {
-    return this->stage != Stage::None;
+int MovePicker::getMovesPicked() const {
+    return this->movesPicked;
 }
 
-// Due to pruning, we don't need to sort the entire array of moves for move ordering.
-// When sorting only small portions of arrays, using partial insertion sort is faster.
 Move MovePicker::pickMove() {
-    assert(this->movesPicked < this->moveList.moves.size());
-
-    const auto begin = this->moveScores.begin() + this->movesPicked;
-    const auto end = this->moveScores.begin() + this->moveList.moves.size();
-    const size_t maxIndex = std::distance(this->moveScores.begin(), std::max_element(begin, end));
-    
-    std::swap(this->moveScores[maxIndex], this->moveScores[this->movesPicked]);
-    std::swap(this->moveList.moves[maxIndex], this->moveList.moves[this->movesPicked]);
-    const auto move = this->moveList.moves[movesPicked];
-    
     ++this->movesPicked;
-    return move;
+    return this->nextMove;
+}
+
+bool MovePicker::pickedQuiet() const {
+    return this->nextIsQuiet;
+}
+
+bool MovePicker::pickedBadCapture() const {
+    return this->pickedPhase == Phase::BadCaptures;
+}
+
+void Histories::clear() {
+    // filled in place; a zeroed temporary would be megabytes on the stack
+    for (auto& fromScores: this->butterfly) {
+        fromScores.fill(0);
+    }
+    for (auto& pieceScores: this->capture) {
+        for (auto& victimScores: pieceScores) {
+            victimScores.fill(0);
+        }
+    }
+    for (auto& pieceTables: this->continuation) {
+        for (auto& table: pieceTables) {
+            for (auto& toScores: table) {
+                toScores.fill(0);
+            }
+        }
+    }
+    for (auto& toMoves: this->counterMoves) {
+        toMoves.fill(Move());
+    }
+}
+
+void Histories::decay() {
+    const auto scale = [](int& entry) {entry = entry * HISTORY_DECAY_NUM / HISTORY_DECAY_DEN;};
+    for (auto& fromScores: this->butterfly) {
+        std::for_each(fromScores.begin(), fromScores.end(), scale);
+    }
+    for (auto& pieceScores: this->capture) {
+        for (auto& victimScores: pieceScores) {
+            std::for_each(victimScores.begin(), victimScores.end(), scale);
+        }
+    }
+    for (auto& pieceTables: this->continuation) {
+        for (auto& table: pieceTables) {
+            for (auto& toScores: table) {
+                std::for_each(toScores.begin(), toScores.end(), scale);
+            }
+        }
+    }
+}
+
+int captureVictimType(const Board& board, Move move) {
+    const pieceTypes victim = board.getPiece(move.sqr2());
+    if (victim != EmptyPiece) {
+        return victim % NUM_PIECES;
+    }
+    const pieceTypes piece = board.getPiece(move.sqr1());
+    if ((piece == WPawn || piece == BPawn) && board.enPassSquare() == move.sqr2()) {
+        return PAWN;
+    }
+    return KING;
 }
 
 int MovePicker::getVictimScore(const Board& board, Move move) const {
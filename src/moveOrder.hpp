@@ -18,7 +18,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
+#include <cstdlib>
 #include <vector>
 
 #include "moveGen.hpp"
@@ -31,32 +34,108 @@ enum Stage {
     None = 0, Captures = 0b01, Quiets = 0b10, All = Captures | Quiets
 };
 
+// history scores are kept within [-HISTORY_MAX, HISTORY_MAX] by the gravity update
+inline constexpr int HISTORY_MAX = 8192;
+// fraction of every history score that is kept when a new search starts
+inline constexpr int HISTORY_DECAY_NUM = 1;
+inline constexpr int HISTORY_DECAY_DEN = 2;
+
+// indexed by [piece][to square]
+using PieceToHistory = std::array<std::array<int, BOARD_SIZE>, NUM_COLORED_PIECES>;
+// indexed by the previous move's [piece][to square], then by the current move's [piece][to square]
+using ContinuationHistory = std::array<std::array<PieceToHistory, BOARD_SIZE>, NUM_COLORED_PIECES>;
+// indexed by [moving piece][to square][victim type]; victim type 0 (the king slot) holds non-capturing promotions
+using CaptureHistory = std::array<std::array<std::array<int, NUM_PIECES>, BOARD_SIZE>, NUM_COLORED_PIECES>;
+// indexed by the previous move's [piece][to square]
+using CounterMoveTable = std::array<std::array<Move, BOARD_SIZE>, NUM_COLORED_PIECES>;
+
+// every move ordering table that is learned during search
+// tables are kept between searches of the same game, so they are aged instead of cleared for each search
+struct Histories {
+    HistoryTable butterfly{};
+    CaptureHistory capture{};
+    ContinuationHistory continuation{};
+    CounterMoveTable counterMoves{};
+
+    void clear();
+    // scales every score down so older information fades as the game moves on
+    void decay();
+};
+
+// continuation histories of the moves played 1 and 2 plies ago; nullptr when there was no such move
+using ContinuationPointers = std::array<const PieceToHistory*, 2>;
+
+// the bonus shrinks as the entry approaches the bound, so entries saturate instead of growing without limit
+inline void updateHistory(int& entry, int bonus) {
+    entry += bonus - entry * std::abs(bonus) / HISTORY_MAX;
+}
+
+inline int historyBonus(int depth) {
+    return std::min(16 * depth * depth + 32 * depth, 1200);
+}
+
+int captureVictimType(const Board& board, Move move);
+
+// moves are handed out in stages and each stage is only generated once it is reached
+// cut nodes that fail high on the TT move never generate any moves at all
 class MovePicker {
     public:
-        MovePicker(const Board& board, const HistoryTable& history, Stage a_stage, Move a_TTMove = Move(), Move a_killerMove = Move());
-        bool movesLeft(const Board& board, const HistoryTable& history);
+        MovePicker(Stage a_stage, Move a_TTMove = Move(), Move a_killerMove = Move(),
+                   Move a_counterMove = Move(), ContinuationPointers a_contHist = {});
+        bool movesLeft(const Board& board, const Histories& histories);
         int getMovesPicked() const;
-        bool stagesLeft() const;
         Move pickMove();
+        bool pickedQuiet() const;
+        // captures that lose material by SEE are picked after every other move
+        bool pickedBadCapture() const;
     private:
-        enum MoveScores {
-            PV = 1 << 30,
-            Capture = 1 << 25,
-            Killer = 1 << 20,
-            Quiet = 0,
+        enum class Phase {
+            TTMove, GenerateCaptures, GoodCaptures, Killer, CounterMove, GenerateQuiets, Quiets, BadCaptures, Done
         };
 
-        template<bool ASSIGN_TTMOVE, Stage STAGE>
-        void assignMoveScores(const Board& board, const HistoryTable& history);
+        void scoreCaptures(const Board& board, const Histories& histories);
+        void scoreQuiets(const Board& board, const Histories& histories);
+        Move selectBest(size_t begin, size_t end);
+        bool setNextMove(Move move, Phase pickedFrom, bool isQuiet);
         int getVictimScore(const Board& board, Move move) const;
 
         MoveList moveList;
-        std::array<int, MAX_MOVES> moveScores;
+        // each entry packs a move's score into the upper 16 bits and the move into the lower 16 bits
+        // so the best move is found with a single max scan over one contiguous array
+        std::array<int32_t, MAX_MOVES> entries;
         Stage stage;
-        Move TTMove, killerMove;
-        unsigned int movesPicked;
+        Phase phase, pickedPhase;
+        Move TTMove, killerMove, counterMove, nextMove;
+        ContinuationPointers contHist;
+        bool nextIsQuiet;
+        // captures are stored first, followed by quiets; losing captures are moved to the front as they are found
+        size_t current, capturesEnd, badCapturesEnd;
+        int movesPicked;
 };
 
+inline int32_t packEntry(Move move, int score) {
+    return std::clamp(score, INT16_MIN, INT16_MAX) * (1 << 16) + move.getData();
+}
+
+inline Move unpackMove(int32_t entry) {
+    return Move::fromData(static_cast<uint16_t>(entry & 0xFFFF));
+}
+
+// swaps the highest entry in [begin, end) to begin and returns it
+inline int32_t selectMaxEntry(int32_t* entries, size_t begin, size_t end) {
+    // the max reduction has no branches and vectorizes; entries are unique, so the second pass finds exactly one
+    int32_t best = entries[begin];
+    for (size_t i = begin + 1; i < end; ++i) {
+        best = std::max(best, entries[i]);
+    }
+    size_t index = begin;
+    while (entries[index] != best) {
+        ++index;
+    }
+    std::swap(entries[index], entries[begin]);
+    return best;
+}
+
 inline constexpr Stage operator&(Stage lhs, Stage rhs) {
     return static_cast<Stage>(static_cast<int>(lhs) & static_cast<int>(rhs));
 }
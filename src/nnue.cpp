@@ -0,0 +1,172 @@
+/*
+* Blocky, a UCI chess engine
+* Copyright (C) 2023-2024, Kevin Nguyen
+*
+* Blocky is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* Blocky is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, see <https://www.gnu.org/licenses>.
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "nnue.hpp"
+#include "utils/types.hpp"
+
+namespace NNUE {
+
+namespace {
+
+Network network;
+bool loaded = false;
+
+// indices are equal to the enumerated pieceTypes of one color
+constexpr std::array<int, NUM_PIECES> NET_PIECE_ORDER = {5, 4, 2, 1, 3, 0};
+
+// raw bytes are read directly, which assumes a little endian host like every supported platform
+template<typename T, size_t N>
+bool readArray(std::istream& stream, std::array<T, N>& array) {
+    stream.read(reinterpret_cast<char*>(array.data()), sizeof(T) * N);
+    return static_cast<bool>(stream);
+}
+
+// sum of clipped relu activations multiplied by the output weights
+int32_t activateAndDot(const std::array<int16_t, HIDDEN_SIZE>& hidden, const int16_t* weights) {
+#if defined(__AVX2__)
+    static_assert(HIDDEN_SIZE % 16 == 0);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ceiling = _mm256_set1_epi16(QA);
+    __m256i sum = _mm256_setzero_si256();
+    for (int i = 0; i < HIDDEN_SIZE; i += 16) {
+        __m256i values = _mm256_load_si256(reinterpret_cast<const __m256i*>(hidden.data() + i));
+        values = _mm256_min_epi16(_mm256_max_epi16(values, zero), ceiling);
+        const __m256i weight = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(values, weight));
+    }
+    __m128i reduced = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    reduced = _mm_add_epi32(reduced, _mm_shuffle_epi32(reduced, _MM_SHUFFLE(1, 0, 3, 2)));
+    reduced = _mm_add_epi32(reduced, _mm_shuffle_epi32(reduced, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(reduced);
+#elif defined(__SSE2__)
+    static_assert(HIDDEN_SIZE % 8 == 0);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ceiling = _mm_set1_epi16(QA);
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < HIDDEN_SIZE; i += 8) {
+        __m128i values = _mm_load_si128(reinterpret_cast<const __m128i*>(hidden.data() + i));
+        values = _mm_min_epi16(_mm_max_epi16(values, zero), ceiling);
+        const __m128i weight = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(values, weight));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+    for (int i = 0; i < HIDDEN_SIZE; ++i) {
+        sum += std::clamp<int32_t>(hidden[i], 0, QA) * weights[i];
+    }
+    return sum;
+#endif
+}
+
+} // namespace
+
+bool load(const std::string& path) {
+    if (path.empty()) {
+        unload();
+        return true;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "info string could not open network file " << path << std::endl;
+        return false;
+    }
+
+    // read into a scratch copy so a bad file never leaves a half loaded network behind
+    auto scratch = std::make_unique<Network>();
+    bool valid = true;
+    for (auto& weights: scratch->featureWeights) {
+        valid = valid && readArray(file, weights);
+    }
+    valid = valid && readArray(file, scratch->featureBias);
+    valid = valid && readArray(file, scratch->outputWeights);
+    valid = valid && file.read(reinterpret_cast<char*>(&scratch->outputBias), sizeof(scratch->outputBias));
+    if (!valid) {
+        std::cout << "info string network file " << path << " is too small for a hidden size of " << HIDDEN_SIZE << std::endl;
+        return false;
+    }
+
+    network = *scratch;
+    loaded = true;
+    return true;
+}
+
+void unload() {
+    loaded = false;
+}
+
+bool isLoaded() {
+    return loaded;
+}
+
+int featureIndex(Square square, pieceTypes piece, bool whitePerspective) {
+    const bool isWhitePiece = piece < BKing;
+    const int pieceIndex = NET_PIECE_ORDER[piece % NUM_PIECES];
+    // squares here start at a8, so white's view is flipped vertically
+    const int relativeSquare = whitePerspective ? square ^ 56 : square;
+    const int side = isWhitePiece == whitePerspective ? 0 : 1;
+    return side * NUM_PIECES * BOARD_SIZE + pieceIndex * BOARD_SIZE + relativeSquare;
+}
+
+void Accumulator::reset() {
+    this->white = network.featureBias;
+    this->black = network.featureBias;
+}
+
+// these loops are simple enough for the compiler to vectorize with whatever instruction set is enabled
+void Accumulator::addPiece(Square square, pieceTypes piece) {
+    const auto& whiteWeights = network.featureWeights[featureIndex(square, piece, true)];
+    const auto& blackWeights = network.featureWeights[featureIndex(square, piece, false)];
+    for (int i = 0; i < HIDDEN_SIZE; ++i) {
+        this->white[i] += whiteWeights[i];
+        this->black[i] += blackWeights[i];
+    }
+}
+
+void Accumulator::removePiece(Square square, pieceTypes piece) {
+    const auto& whiteWeights = network.featureWeights[featureIndex(square, piece, true)];
+    const auto& blackWeights = network.featureWeights[featureIndex(square, piece, false)];
+    for (int i = 0; i < HIDDEN_SIZE; ++i) {
+        this->white[i] -= whiteWeights[i];
+        this->black[i] -= blackWeights[i];
+    }
+}
+
+int evaluate(const Accumulator& accumulator, bool isWhiteTurn) {
+    const auto& us = isWhiteTurn ? accumulator.white : accumulator.black;
+    const auto& them = isWhiteTurn ? accumulator.black : accumulator.white;
+    int32_t output = activateAndDot(us, network.outputWeights.data());
+    output += activateAndDot(them, network.outputWeights.data() + HIDDEN_SIZE);
+    output += network.outputBias;
+    const int eval = static_cast<int>(static_cast<int64_t>(output) * EVAL_SCALE / (QA * QB));
+    return std::clamp(eval, -MAX_EVAL, MAX_EVAL);
+}
+
+} // namespace NNUE
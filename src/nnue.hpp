@@ -0,0 +1,72 @@
+/*
+* Blocky, a UCI chess engine
+* Copyright (C) 2023-2024, Kevin Nguyen
+*
+* Blocky is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* Blocky is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, see <https://www.gnu.org/licenses>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "utils/types.hpp"
+
+// an optional efficiently updatable neural network evaluation, a (768->HIDDEN_SIZE)x2->1 perspective net
+// the hand-crafted evaluation is used whenever no network is loaded
+namespace NNUE {
+
+inline constexpr int INPUT_SIZE = 2 * NUM_PIECES * BOARD_SIZE;
+inline constexpr int HIDDEN_SIZE = 256;
+// quantization of the hidden layer and output layer, and the scale that converts the output to centipawns
+inline constexpr int QA = 255;
+inline constexpr int QB = 64;
+inline constexpr int EVAL_SCALE = 400;
+// keeps network outputs clear of mate scores
+inline constexpr int MAX_EVAL = 30000;
+
+// the file layout matches what common trainers export for this architecture: little endian int16 values of
+// feature weights [INPUT_SIZE][HIDDEN_SIZE], feature biases [HIDDEN_SIZE],
+// output weights [2 * HIDDEN_SIZE] (side to move first), then the output bias; trailing padding is ignored
+struct Network {
+    alignas(64) std::array<std::array<int16_t, HIDDEN_SIZE>, INPUT_SIZE> featureWeights;
+    alignas(64) std::array<int16_t, HIDDEN_SIZE> featureBias;
+    alignas(64) std::array<int16_t, 2 * HIDDEN_SIZE> outputWeights;
+    int16_t outputBias;
+};
+
+// hidden layer values from both perspectives, kept up to date as pieces are added and removed
+struct Accumulator {
+    alignas(64) std::array<int16_t, HIDDEN_SIZE> white;
+    alignas(64) std::array<int16_t, HIDDEN_SIZE> black;
+
+    // sets both perspectives to an empty board
+    void reset();
+    void addPiece(Square square, pieceTypes piece);
+    void removePiece(Square square, pieceTypes piece);
+};
+
+// an empty path unloads the network; on failure the previous state is kept
+bool load(const std::string& path);
+void unload();
+bool isLoaded();
+
+// positive values are winning for the side to move
+int evaluate(const Accumulator& accumulator, bool isWhiteTurn);
+
+// pieces are ordered pawn, knight, bishop, rook, queen, king and squares start at a1 from each perspective's side
+int featureIndex(Square square, pieceTypes piece, bool whitePerspective);
+
+} // namespace NNUE
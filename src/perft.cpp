@@ -0,0 +1,136 @@
+/*
+* Blocky, a UCI chess engine
+* Copyright (C) 2023-2024, Kevin Nguyen
+*
+* Blocky is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* Blocky is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, see <https://www.gnu.org/licenses>.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "perft.hpp"
+
+PerftTable::PerftTable(uint64_t sizeMb) {
+    this->numSlots = std::max<uint64_t>(1, sizeMb * 1024 * 1024 / sizeof(Slot));
+    this->slots = std::make_unique<Slot[]>(this->numSlots);
+}
+
+uint64_t PerftTable::getIndex(uint64_t key, int depth) const {
+    // mix the depth in so the same position at different depths lands in different slots
+    const uint64_t mixed = key ^ (static_cast<uint64_t>(depth) * 0x9E3779B97F4A7C15ull);
+    return static_cast<uint64_t>((static_cast<__uint128_t>(mixed) * this->numSlots) >> 64);
+}
+
+bool PerftTable::probe(uint64_t key, int depth, uint64_t& nodes) const {
+    const Slot& slot = this->slots[this->getIndex(key, depth)];
+    const uint64_t data = slot.data.load(std::memory_order_relaxed);
+    const uint64_t check = slot.check.load(std::memory_order_relaxed);
+    if ((check ^ data) != key || static_cast<int>(data & 0xFF) != depth) {
+        return false;
+    }
+    nodes = data >> 8;
+    return true;
+}
+
+void PerftTable::store(uint64_t key, int depth, uint64_t nodes) {
+    Slot& slot = this->slots[this->getIndex(key, depth)];
+    const uint64_t data = (nodes << 8) | static_cast<uint64_t>(depth);
+    slot.data.store(data, std::memory_order_relaxed);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+}
+
+uint64_t hashedPerft(Board& board, int depthLeft, PerftTable& table) {
+    if (depthLeft == 0) {
+        return 1;
+    }
+
+    MoveList gen(board);
+    gen.generateAllMoves(board);
+    if (depthLeft == 1) {
+        return gen.moves.size();
+    }
+
+    uint64_t leafNodeCount = 0;
+    if (table.probe(board.zobristKey(), depthLeft, leafNodeCount)) {
+        return leafNodeCount;
+    }
+
+    for (Move move: gen.moves) {
+        board.makeMove(move);
+        leafNodeCount += hashedPerft(board, depthLeft - 1, table);
+        board.undoMove();
+    }
+    table.store(board.zobristKey(), depthLeft, leafNodeCount);
+    return leafNodeCount;
+}
+
+uint64_t parallelPerft(const Board& board, int depth, int numThreads, uint64_t hashMb, bool printInfo) {
+    if (depth <= 1) {
+        Board copy = board;
+        return perft<false>(copy, depth);
+    }
+
+    MoveList gen(board);
+    gen.generateAllMoves(board);
+
+    PerftTable table(hashMb);
+    std::vector<uint64_t> moveCounts(gen.moves.size(), 0);
+    std::vector<uint64_t> threadNodes(numThreads, 0);
+    std::vector<int64_t> threadTimes(numThreads, 0);
+    std::atomic<size_t> nextMove = 0;
+
+    // each thread pulls the next unsearched root move until none are left
+    auto worker = [&](int threadId) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        Board threadBoard = board;
+        for (size_t i = nextMove++; i < gen.moves.size(); i = nextMove++) {
+            threadBoard.makeMove(gen.moves[i]);
+            moveCounts[i] = hashedPerft(threadBoard, depth - 1, table);
+            threadBoard.undoMove();
+            threadNodes[threadId] += moveCounts[i];
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+        threadTimes[threadId] = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < numThreads; i++) {
+        threads.emplace_back(worker, i);
+    }
+    worker(0);
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+
+    uint64_t leafNodeCount = 0;
+    for (size_t i = 0; i < gen.moves.size(); i++) {
+        leafNodeCount += moveCounts[i];
+        if (printInfo) {
+            std::cout << gen.moves[i] << ": " << moveCounts[i] << "\n";
+        }
+    }
+    if (printInfo) {
+        std::ostringstream output;
+        for (int i = 0; i < numThreads; i++) {
+            output << "info string thread " << i << " nodes " << threadNodes[i];
+            output << " nps " << threadNodes[i] * 1000000 / std::max<int64_t>(threadTimes[i], 1);
+            output << " time " << threadTimes[i] / 1000 << "\n";
+        }
+        std::cout << output.str() << std::flush;
+    }
+    return leafNodeCount;
+}
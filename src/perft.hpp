@@ -18,7 +18,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 
 #include "moveGen.hpp"
 #include "moveOrder.hpp"
@@ -61,11 +64,12 @@ uint64_t perftMovePicker(Board& board, int depthLeft) {
         return 1;
     }
 
-    HistoryTable unusedHistory;
-    MoveOrder::MovePicker movePicker(board, unusedHistory, MoveOrder::All);
+    // too large for the stack, and never written to
+    static const MoveOrder::Histories unusedHistories{};
+    MoveOrder::MovePicker movePicker(MoveOrder::All);
     uint64_t leafNodeCount = 0;
 
-    while (movePicker.movesLeft(board, unusedHistory)) {
+    while (movePicker.movesLeft(board, unusedHistories)) {
         const Move move = movePicker.pickMove();
         board.makeMove(move);
         const uint64_t moveCount = perftMovePicker<false>(board, depthLeft - 1);
@@ -77,3 +81,32 @@ uint64_t perftMovePicker(Board& board, int depthLeft) {
     }
     return leafNodeCount;
 }
+
+// perft hash used by parallelPerft; every slot is shared between the perft threads
+// slots use the xor trick so a torn write from another thread is detected on probe
+class PerftTable {
+    public:
+        PerftTable(uint64_t sizeMb);
+
+        bool probe(uint64_t key, int depth, uint64_t& nodes) const;
+        void store(uint64_t key, int depth, uint64_t nodes);
+    private:
+        struct Slot {
+            std::atomic<uint64_t> check; // key ^ data
+            std::atomic<uint64_t> data; // nodes in the upper 56 bits, depth in the lower 8
+        };
+
+        uint64_t getIndex(uint64_t key, int depth) const;
+
+        std::unique_ptr<Slot[]> slots;
+        uint64_t numSlots;
+};
+
+constexpr uint64_t PERFT_HASH_MB = 64;
+
+// hashed perft with bulk counting at depth 1
+uint64_t hashedPerft(Board& board, int depthLeft, PerftTable& table);
+
+// root moves are split between numThreads threads, each searching its own copy of the board
+// prints the node count of every root move followed by the nodes and nps of every thread
+uint64_t parallelPerft(const Board& board, int depth, int numThreads, uint64_t hashMb = PERFT_HASH_MB, bool printInfo = true);
@@ -21,6 +21,8 @@
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 #include "search.hpp"
 #include "ttable.hpp"
@@ -34,6 +36,9 @@
 
 namespace Search {
 
+// global definition
+ThreadPool Threads = ThreadPool();
+
 std::array<std::array<int, MAX_MOVES>, MAX_PLY> LMRTable{};
 void initLMRTable() {
     for (int depth = 1; depth < MAX_PLY; ++depth) {
@@ -45,19 +50,23 @@ void initLMRTable() {
 
 Info Searcher::startThinking() {
     Info result;
+    this->pondering = this->pool.isPondering();
 
     // stack needs to label distances from root
     for (size_t i = 0; i < this->stack.size(); ++i) {
         this->stack[i].ply = i;
     }
 
+    // helper threads skip alternating depths so they spread out over the tree instead of mirroring the main thread
+    const int startDepth = this->isMainThread() ? 1 : 1 + this->threadId % 2;
+
     // perform iterative deepening
     int prevEval = NO_SCORE;
-    for (int i = 1; i <= this->depth_limit; i++) {
+    for (int i = startDepth; i <= this->depth_limit; i++) {
         const int score = this->aspiration(i, prevEval);
         prevEval = score;
         result.move = this->PVTable[0].moves[0];
-        result.nodes = this->nodes;
+        result.nodes = this->isMainThread() ? this->pool.getNodes() : this->getNodes();
         result.timeElapsed = this->tm.getTimeElapsed();
 
         // if it's not possible to search deeper, stop searching 
@@ -71,6 +80,7 @@ Info Searcher::startThinking() {
         // only update eval for completed searches
         if (!this->stopSearching()) {
             result.eval = score;
+            this->completedDepth = i;
         }
 
         // compute mate-in
@@ -79,13 +89,18 @@ Info Searcher::startThinking() {
             result.mateIn = playerMating * (INF_SCORE - abs(result.eval)); // convert eval to ply
             result.mateIn = (result.mateIn + playerMating) / 2; // convert ply to moves
         }
+        this->lastResult = result;
 
-        if (this->printInfo) {
+        if (this->printInfo && this->isMainThread()) {
             this->outputUciInfo(result);
         }
         
+        // helpers keep searching until the main thread stops them
+        if (this->stopSearching()) {
+            break;
+        }
         // break out of search early for optimistic time used; this also applies to hard time up
-        if (this->tm.softTimeUp()) {
+        if (this->isMainThread() && !this->clockPaused() && this->tm.softTimeUp()) {
             break;
         }
     }
@@ -135,10 +150,10 @@ int Searcher::search(int alpha, int beta, int depth, StackEntry* ss) {
         return NO_SCORE;
     }
 
-    ++this->nodes;
+    this->incrementNodes();
     this->max_seldepth = std::max(ss->ply, this->max_seldepth);
 
-    if (this->board.isDraw()) {
+    if (this->board.isDraw(ss->ply)) {
         return DRAW_SCORE;
     }
     // max depth reached
@@ -150,22 +165,30 @@ int Searcher::search(int alpha, int beta, int depth, StackEntry* ss) {
      * Probe Tranposition Table
     *************/
     Move TTMove;
-    int staticEval;
-    if (TTable::Table.entryExists(this->board.zobristKey())) {
-        const TTable::Entry entry = TTable::Table.getEntry(this->board.zobristKey());
-
-        if (!ISPV && entry.depth >= depth) {
-            if (entry.bound == EvalType::EXACT
-                || (entry.bound == EvalType::UPPER && entry.eval <= alpha)
-                || (entry.bound == EvalType::LOWER && entry.eval >= beta)) {
+    int staticEval, eval;
+    TTable::Entry entry;
+    if (TTable::Table.probe(this->board.zobristKey(), entry)) {
+        const EvalType bound = entry.getBound();
+        if (!ISPV && entry.getDepth() >= depth) {
+            if (bound == EvalType::EXACT
+                || (bound == EvalType::UPPER && entry.eval <= alpha)
+                || (bound == EvalType::LOWER && entry.eval >= beta)) {
                 return entry.eval;
             }
         }
 
         TTMove = entry.move;
-        staticEval = entry.eval;
+        staticEval = entry.staticEval;
+
+        // the search score is a better estimate than the static evaluation whenever its bound allows it
+        eval = staticEval;
+        if (bound == EvalType::EXACT
+            || (bound == EvalType::LOWER && entry.eval > staticEval)
+            || (bound == EvalType::UPPER && entry.eval < staticEval)) {
+            eval = entry.eval;
+        }
     } else {
-        staticEval = this->board.evaluate();
+        staticEval = eval = this->board.evaluate(this->pawnCache);
     }
 
     /************
@@ -180,11 +203,11 @@ int Searcher::search(int alpha, int beta, int depth, StackEntry* ss) {
      * Reverse Futility Pruning
      * If the evaluation is too far above beta, assume that there is no chance for the opponent to catch up
     *************/
-    if (!ISPV && depth < 5 && staticEval - (100 * depth) >= beta) {
+    if (!ISPV && depth < 5 && eval - (100 * depth) >= beta) {
         return beta;
     }
 
-    const bool inCheck = currKingInAttack(this->board.pieceSets, this->board.isWhiteTurn());
+    const bool inCheck = this->board.inCheck();
     /************
      * Null Move Pruning
      * Give the opponent a free move and see if our position is still too good after that; if so, prune
@@ -193,13 +216,16 @@ int Searcher::search(int alpha, int beta, int depth, StackEntry* ss) {
     if (!ISNMP
         && !inCheck
         && depth >= 2
-        && staticEval >= beta
+        && eval >= beta
         && this->board.hasNonPawnMat()) {
 
         // prefetch TT entry as soon as possible; NMP only changes color
         TTable::Table.prefetch(this->board.zobristKey() ^ Zobrist::isBlackKey);
 
         int reduction = 3 + depth / 4;
+        ss->currentMove = Move();
+        ss->movedPiece = EmptyPiece;
+        ss->contHist = nullptr;
         board.makeNullMove();
         int nullMoveScore = -search<NMP>(-beta, -beta + 1, depth - reduction, ss + 1);
         board.unmakeNullMove();
@@ -212,18 +238,25 @@ int Searcher::search(int alpha, int beta, int depth, StackEntry* ss) {
         }
     }
 
+    // the counter move is the quiet that last refuted the opponent's previous move
+    Move counterMove{};
+    if (ss->ply >= 1 && (ss - 1)->movedPiece != EmptyPiece) {
+        counterMove = this->histories.counterMoves[(ss - 1)->movedPiece][(ss - 1)->currentMove.sqr2()];
+    }
+
     // init movePicker
-    MoveOrder::MovePicker movePicker(this->board, this->history, MoveOrder::All, TTMove, ss->killerMove);
+    MoveOrder::MovePicker movePicker(MoveOrder::All, TTMove, ss->killerMove, counterMove, this->getContinuations(ss));
 
     // start search through moves
     int score = NO_SCORE, bestscore = -INF_SCORE;
     Move bestMove{};
     FixedVector<Move, MAX_MOVES> failedQuiets{};
+    FixedVector<Move, MAX_MOVES> failedCaptures{};
     bool doFullNullSearch, doPVS, skipQuiets = false;
 
-    while (movePicker.movesLeft(this->board, this->history)) {
+    while (movePicker.movesLeft(this->board, this->histories)) {
         const Move move = movePicker.pickMove();
-        const bool quietMove = !movePicker.stagesLeft();
+        const bool quietMove = movePicker.pickedQuiet();
 
         /*************
          * Late Move Pruning:
@@ -242,10 +275,14 @@ int Searcher::search(int alpha, int beta, int depth, StackEntry* ss) {
             continue;
         }
 
+        ss->currentMove = move;
+        ss->movedPiece = this->board.getPiece(move.sqr1());
+        ss->contHist = &this->histories.continuation[ss->movedPiece][move.sqr2()];
+
         board.makeMove(move);
         // prefetch TT entry as soon as possible
         TTable::Table.prefetch(this->board.zobristKey());
-        const bool moveGivesCheck = currKingInAttack(this->board.pieceSets, this->board.isWhiteTurn());
+        const bool moveGivesCheck = this->board.inCheck();
 
         /*************
          * Extensions:
@@ -311,25 +348,37 @@ int Searcher::search(int alpha, int beta, int depth, StackEntry* ss) {
 
                 // prune if a move is too good, opponent will avoid playing into this node
                 if (score >= beta) {
-                    // updating history and killer moves orders then ahead of other moves
-                    this->history[move.sqr1()][move.sqr2()] += depth * (depth - 1);
+                    // updating histories and killer moves orders them ahead of other moves
+                    const int bonus = MoveOrder::historyBonus(depth);
                     if (quietMove) {
                         ss->killerMove = move;
+                        if (ss->ply >= 1 && (ss - 1)->movedPiece != EmptyPiece) {
+                            this->histories.counterMoves[(ss - 1)->movedPiece][(ss - 1)->currentMove.sqr2()] = move;
+                        }
+                        this->updateQuietHistories(ss, move, bonus);
 
                         // apply malus for quiets that didn't cause beta cutoffs
                         // these quiets were ordered ahead of the cutting move, so they should be penalized
                         for (const auto& quiet: failedQuiets) {
-                            this->history[quiet.sqr1()][quiet.sqr2()] -= depth * (depth - 1);
+                            this->updateQuietHistories(ss, quiet, -bonus);
                         }
+                    } else {
+                        this->updateCaptureHistory(move, bonus);
+                    }
+                    // captures are tried before quiets, so every capture searched before the cutoff failed to cut
+                    for (const auto& capture: failedCaptures) {
+                        this->updateCaptureHistory(capture, -bonus);
                     }
                     break;
                 }
             }
         }
 
-        // keep track of all quiets that didn't generate cutoffs
+        // keep track of all moves that didn't generate cutoffs
         if (quietMove) {
             failedQuiets.push_back(move);
+        } else {
+            failedCaptures.push_back(move);
         }
     }
 
@@ -344,7 +393,7 @@ int Searcher::search(int alpha, int beta, int depth, StackEntry* ss) {
     // store results with best moves in transposition table
     if (bestMove) {
         const EvalType bound = (bestscore >= beta) ? EvalType::LOWER : (alpha == oldAlpha) ? EvalType::UPPER : EvalType::EXACT;
-        TTable::Table.store(bestscore, bestMove, bound, depth, this->board.zobristKey());
+        TTable::Table.store(bestscore, staticEval, bestMove, bound, depth, this->board.zobristKey());
     }
     return bestscore;
 }
@@ -354,67 +403,171 @@ int Searcher::quiesce(int alpha, int beta, StackEntry* ss) {
         return NO_SCORE;
     }
 
-    ++this->nodes;
+    this->incrementNodes();
     this->max_seldepth = std::max(ss->ply, this->max_seldepth);
+    const int oldAlpha = alpha;
+    const uint64_t key = this->board.zobristKey();
+
+    /************
+     * Probe Tranposition Table
+     * Any entry is deep enough for quiescence; the stored static evaluation doubles as the stand pat
+    *************/
+    int stand_pat;
+    TTable::Entry entry;
+    if (TTable::Table.probe(key, entry)) {
+        const EvalType bound = entry.getBound();
+        if (bound == EvalType::EXACT
+            || (bound == EvalType::UPPER && entry.eval <= alpha)
+            || (bound == EvalType::LOWER && entry.eval >= beta)) {
+            return entry.eval;
+        }
+        stand_pat = entry.staticEval;
+    } else {
+        stand_pat = this->board.evaluate(this->pawnCache);
+    }
 
-    const int stand_pat = this->board.evaluate();
-    if (stand_pat >= beta)
+    if (stand_pat >= beta) {
+        TTable::Table.store(beta, stand_pat, Move(), EvalType::LOWER, 0, key);
         return beta;
+    }
     if (alpha < stand_pat)
         alpha = stand_pat;
 
-    MoveOrder::MovePicker movePicker(this->board, this->history, MoveOrder::Captures);
+    /************
+     * Delta Pruning
+     * If winning a queen can't raise alpha then no capture can; promotions are the only way to gain more
+    *************/
+    const int deltaMargin = 200;
+    const uint64_t promotingPawns = this->board.pieceSets.get(PAWN, this->board.isWhiteTurn())
+                                  & (this->board.isWhiteTurn() ? RANK_7 : RANK_2);
+    if (!promotingPawns && stand_pat + Eval::getMaxPieceValue(QUEEN) + deltaMargin < alpha) {
+        return alpha;
+    }
+
+    MoveOrder::MovePicker movePicker(MoveOrder::Captures);
     int score = -INF_SCORE;
-    while (movePicker.movesLeft(this->board, this->history)) {
+    Move bestMove{};
+    while (movePicker.movesLeft(this->board, this->histories)) {
         Move move = movePicker.pickMove();
+        // the remaining captures all lose material, so they can't improve on the stand pat
+        if (movePicker.pickedBadCapture()) {
+            break;
+        }
+        // captures that can't raise alpha even with a margin are skipped without making them
+        const pieceTypes victim = this->board.getPiece(move.sqr2());
+        const int victimValue = Eval::getMaxPieceValue(victim != EmptyPiece ? victim : PAWN);
+        if (move.promotePiece() == EmptyPiece && stand_pat + victimValue + deltaMargin <= alpha) {
+            continue;
+        }
         board.makeMove(move);
         score = -quiesce(-beta, -alpha, ss + 1);
         board.undoMove(); 
 
-        if (score >= beta)
+        // results are incomplete when time is up, so they must not reach the transposition table
+        if (this->stopSearching()) {
+            return NO_SCORE;
+        }
+
+        if (score >= beta) {
+            TTable::Table.store(beta, stand_pat, move, EvalType::LOWER, 0, key);
             return beta;
-        if (score > alpha)
+        }
+        if (score > alpha) {
             alpha = score;
+            bestMove = move;
+        }
     }
+
+    const EvalType bound = alpha > oldAlpha ? EvalType::EXACT : EvalType::UPPER;
+    TTable::Table.store(alpha, stand_pat, bestMove, bound, 0, key);
     return alpha;
+}
+
+// continuation histories of the moves made 1 and 2 plies before this node
+MoveOrder::ContinuationPointers Searcher::getContinuations(const StackEntry* ss) const {
+    MoveOrder::ContinuationPointers contHist{};
+    for (int i = 1; i <= static_cast<int>(contHist.size()) && i <= ss->ply; ++i) {
+        contHist[i - 1] = (ss - i)->contHist;
+    }
+    return contHist;
+}
 
+void Searcher::updateQuietHistories(StackEntry* ss, Move move, int bonus) {
+    const pieceTypes piece = this->board.getPiece(move.sqr1());
+    MoveOrder::updateHistory(this->histories.butterfly[move.sqr1()][move.sqr2()], bonus);
+    for (int i = 1; i <= 2 && i <= ss->ply; ++i) {
+        MoveOrder::PieceToHistory* contHist = (ss - i)->contHist;
+        if (contHist != nullptr) {
+            MoveOrder::updateHistory((*contHist)[piece][move.sqr2()], bonus);
+        }
+    }
 }
 
+void Searcher::updateCaptureHistory(Move move, int bonus) {
+    const pieceTypes piece = this->board.getPiece(move.sqr1());
+    const int victimType = MoveOrder::captureVictimType(this->board, move);
+    MoveOrder::updateHistory(this->histories.capture[piece][move.sqr2()][victimType], bonus);
+}
 
 bool Searcher::stopSearching() {
-    // only check system time every 1024 nodes for performance
-    if (this->nodes % 1024 == 0 && !this->stopSearchFlag) {
-        this->stopSearchFlag = this->tm.hardTimeUp();
+    // only the main thread checks system time, and only every 1024 nodes for performance
+    if (this->isMainThread()
+        && this->getNodes() % 1024 == 0
+        && !this->pool.stopped()
+        && !this->clockPaused()
+        && this->tm.hardTimeUp()) {
+
+        this->pool.stop();
+    }
+    return this->pool.stopped();
+}
+
+// time is ignored while pondering since the opponent's clock is running
+// our clock only starts once ponderhit is seen, so pondering never eats into the allotted time
+bool Searcher::clockPaused() {
+    if (this->pondering) {
+        if (this->pool.isPondering()) {
+            return true;
+        }
+        this->pondering = false;
+        this->tm.restart();
     }
-    return this->stopSearchFlag;
+    return false;
+}
+
+void Searcher::incrementNodes() {
+    // no other thread writes to this counter, so a relaxed load and store avoids a locked increment
+    this->nodes.store(this->getNodes() + 1, std::memory_order_relaxed);
 }
 
 void Searcher::outputUciInfo(Info searchResult) const {
-    std::cout << "info depth " << searchResult.depth << ' ';
-    std::cout << "seldepth " << searchResult.seldepth << ' ';
-    std::cout << "nodes " << searchResult.nodes << ' ';
+    // info is buffered and printed at once so it can't interleave with uci responses from another thread
+    std::ostringstream out;
+    out << "info depth " << searchResult.depth << ' ';
+    out << "seldepth " << searchResult.seldepth << ' ';
+    out << "nodes " << searchResult.nodes << ' ';
 
     // time is output in milliseconds per the UCI protocol
-    std::cout << "time " << searchResult.timeElapsed << ' ';
+    out << "time " << searchResult.timeElapsed << ' ';
     if (searchResult.timeElapsed > 0) { // prevents divide by 0
-        std::cout << "nps " << searchResult.nodes * 1000 / searchResult.timeElapsed  << ' ';
+        out << "nps " << searchResult.nodes * 1000 / searchResult.timeElapsed  << ' ';
     }
     
     if (searchResult.mateIn == NO_SCORE) {
-        std::cout << "score cp " << searchResult.eval << ' ';
+        out << "score cp " << searchResult.eval << ' ';
     } else {
-        std::cout << "score mate " << searchResult.mateIn << ' ';
+        out << "score mate " << searchResult.mateIn << ' ';
     }
-    std::cout << "hashfull " << TTable::Table.hashFull() << ' ';
+    out << "hashfull " << TTable::Table.hashFull() << ' ';
 
     // principle variations are checked for a valid sequence of moves; if not valid, a warning is given;
-    std::cout << "pv ";
+    out << "pv ";
     Board tmpBoard = this->board;
     Move move;
     bool illegalMove = false;
     for (int i = 0; i < this->PVTable[0].length; ++i) {
         move = this->PVTable[0].moves[i];
-        std::cout << move.toStr() << ' ';
+        out << move.toStr() << ' ';
         if (!tmpBoard.isLegalMove(move)) {
             illegalMove = true;
             break;
@@ -422,11 +575,151 @@ void Searcher::outputUciInfo(Info searchResult) const {
 
         tmpBoard.makeMove(move);
     }
-    std::cout << std::endl;
+    out << '\n';
 
     if (illegalMove) {
-        std::cout << "Warning! illegal move in PV: " << move.toStr() << std::endl;
+        out << "Warning! illegal move in PV: " << move.toStr() << '\n';
+    }
+    std::cout << out.str() << std::flush;
+}
+
+void ThreadPool::resize(int a_numThreads) {
+    this->numThreads = std::clamp(a_numThreads, MIN_THREADS, MAX_THREADS);
+    while (static_cast<int>(this->pawnCaches.size()) < this->numThreads) {
+        this->pawnCaches.push_back(std::make_unique<Eval::PawnCache>(this->pawnCacheMb));
+    }
+    this->pawnCaches.resize(this->numThreads);
+    while (static_cast<int>(this->histories.size()) < this->numThreads) {
+        this->histories.push_back(std::make_unique<MoveOrder::Histories>());
+    }
+    this->histories.resize(this->numThreads);
+}
+
+void ThreadPool::resizePawnCaches(uint64_t sizeMb) {
+    this->pawnCacheMb = sizeMb;
+    for (auto& pawnCache: this->pawnCaches) {
+        pawnCache->resize(sizeMb);
+    }
+}
+
+void ThreadPool::clearPawnCaches() {
+    for (auto& pawnCache: this->pawnCaches) {
+        pawnCache->clear();
+    }
+}
+
+std::pair<uint64_t, uint64_t> ThreadPool::getPawnCacheStats() const {
+    uint64_t hits = 0, probes = 0;
+    for (const auto& pawnCache: this->pawnCaches) {
+        hits += pawnCache->getHits();
+        probes += pawnCache->getProbes();
+    }
+    return {hits, probes};
+}
+
+void ThreadPool::clearHistories() {
+    for (auto& threadHistories: this->histories) {
+        threadHistories->clear();
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    this->stop();
+    this->wait();
+}
+
+Info ThreadPool::startThinking(const Board& board, Timeman::TimeManager tm, int depthLimit, bool printInfo) {
+    TTable::Table.newSearch();
+    this->stopFlag.store(false, std::memory_order_relaxed);
+    this->pondering.store(false, std::memory_order_relaxed);
+    this->infinite = false;
+    return this->search(board, tm, depthLimit, printInfo);
+}
+
+void ThreadPool::go(const Board& board, Timeman::TimeManager tm, int depthLimit, bool a_infinite, bool ponder) {
+    // a previous infinite or ponder search would otherwise never finish
+    this->stop();
+    this->wait();
+
+    // flags are reset before the thread starts so that an early stop is never lost
+    this->stopFlag.store(false, std::memory_order_relaxed);
+    this->pondering.store(ponder, std::memory_order_relaxed);
+    this->infinite = a_infinite;
+    TTable::Table.newSearch();
+    this->mainThread = std::thread([this, board, tm, depthLimit] {
+        const Info result = this->search(board, tm, depthLimit, true);
+        std::cout << "bestmove " << result.move.toStr() << std::endl;
+    });
+}
+
+void ThreadPool::wait() {
+    if (this->mainThread.joinable()) {
+        this->mainThread.join();
+    }
+}
+
+void ThreadPool::stop() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopFlag.store(true, std::memory_order_relaxed);
+    this->stopCondition.notify_all();
+}
+
+void ThreadPool::ponderhit() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->pondering.store(false, std::memory_order_relaxed);
+    this->stopCondition.notify_all();
+}
+
+Info ThreadPool::search(const Board& board, Timeman::TimeManager tm, int depthLimit, bool printInfo) {
+    // every search gets fresh searchers; each thread owns its own board, stack, and pv table
+    // histories are owned by the pool so that they outlive the searchers
+    this->searchers.clear();
+    for (int i = 0; i < this->numThreads; ++i) {
+        this->histories[i]->decay();
+        this->searchers.push_back(std::make_unique<Searcher>(board, tm, depthLimit, *this, i, *this->pawnCaches[i], *this->histories[i]));
+        this->searchers.back()->setPrintInfo(printInfo);
+    }
+
+    // helpers search in the background until the main thread finishes
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < this->numThreads; ++i) {
+        helpers.emplace_back([this, i] {this->searchers[i]->startThinking();});
+    }
+    Info result = this->searchers[0]->startThinking();
+
+    // uci forbids sending bestmove during infinite or ponder searches until the gui tells us to
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->stopCondition.wait(lock, [this] {return this->stopped() || (!this->infinite && !this->isPondering());});
+    }
+    this->stop();
+    for (auto& helper: helpers) {
+        helper.join();
+    }
+
+    // prefer the thread with the deepest completed iteration; ties go to the better score
+    const Searcher* best = this->searchers[0].get();
+    for (const auto& searcher: this->searchers) {
+        const bool deeper = searcher->getCompletedDepth() > best->getCompletedDepth();
+        const bool sameDepthBetter = searcher->getCompletedDepth() == best->getCompletedDepth()
+                                  && searcher->getResult().eval > best->getResult().eval;
+        if (searcher->getResult().move && (deeper || sameDepthBetter)) {
+            best = searcher.get();
+        }
+    }
+    if (best != this->searchers[0].get()) {
+        result = best->getResult();
+    }
+    result.nodes = this->getNodes();
+    return result;
+}
+
+uint64_t ThreadPool::getNodes() const {
+    uint64_t nodes = 0;
+    for (const auto& searcher: this->searchers) {
+        nodes += searcher->getNodes();
     }
+    return nodes;
 }
 
 } // namespace Search
@@ -18,10 +18,18 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "board.hpp"
 #include "eval.hpp"
+#include "moveOrder.hpp"
 #include "ttable.hpp"
 #include "timeman.hpp"
 #include "utils/types.hpp"
@@ -29,9 +37,12 @@
 namespace Search {
 
 inline constexpr int DRAW_SCORE = 0;
-inline constexpr int INF_SCORE = 1000000;
+// scores fit in 16 bits so they can be packed into transposition table entries
+inline constexpr int INF_SCORE = 32000;
 inline constexpr int MATE_IN_SCORE = INF_SCORE - MAX_PLY;
 inline constexpr int NO_SCORE = -100000000;
+inline constexpr int MIN_THREADS = 1;
+inline constexpr int MAX_THREADS = 256;
 
 void initLMRTable();
 
@@ -54,38 +65,109 @@ struct PVRow {
 
 struct StackEntry {
     Move killerMove{};
+    // the move made from this node and its continuation history; both are empty for null moves
+    Move currentMove{};
+    pieceTypes movedPiece = EmptyPiece;
+    MoveOrder::PieceToHistory* contHist = nullptr;
     int ply{};
 };
 
+class ThreadPool;
+
 class Searcher {
     public:  
-        Searcher(Board a_board, Timeman::TimeManager a_tm, int depthLimit) {
+        Searcher(Board a_board, Timeman::TimeManager a_tm, int depthLimit, ThreadPool& a_pool, int a_threadId,
+                 Eval::PawnCache& a_pawnCache, MoveOrder::Histories& a_histories)
+            : histories(a_histories), pawnCache(a_pawnCache), pool(a_pool) {
             this->board = a_board;
             this->tm = a_tm;
             this->depth_limit = depthLimit;
+            this->threadId = a_threadId;
         };
         Info startThinking();
         void setPrintInfo(bool flag) {this->printInfo = flag;};
+        uint64_t getNodes() const {return this->nodes.load(std::memory_order_relaxed);};
+        int getCompletedDepth() const {return this->completedDepth;};
+        const Info& getResult() const {return this->lastResult;};
     private:
         int aspiration(int depth, int prevEval);
         template <NodeTypes NODE>
         int search(int alpha, int beta, int depth, StackEntry* ss);
         int quiesce(int alpha, int beta, StackEntry* ss);
+        MoveOrder::ContinuationPointers getContinuations(const StackEntry* ss) const;
+        void updateQuietHistories(StackEntry* ss, Move move, int bonus);
+        void updateCaptureHistory(Move move, int bonus);
         bool stopSearching();
+        bool clockPaused();
+        bool isMainThread() const {return this->threadId == 0;};
+        void incrementNodes();
         void outputUciInfo(Info searchResult) const;
 
         Board board;
-        uint64_t nodes{};
+        // only written by the owning thread; atomic so the main thread can sum node counts while searching
+        std::atomic<uint64_t> nodes{};
         int max_seldepth{};
 
         std::array<StackEntry, MAX_PLY> stack{};
         std::array<PVRow, MAX_PLY> PVTable;
-        HistoryTable history{};
+        MoveOrder::Histories& histories;
+        Eval::PawnCache& pawnCache;
 
         Timeman::TimeManager tm{};
+        // set while a ponder search has not seen ponderhit yet; only used by the main thread
+        bool pondering{};
         int depth_limit{};
         bool printInfo = true;
-        bool stopSearchFlag = false;
+
+        // lazy smp: every thread searches the same root and shares work through the transposition table
+        ThreadPool& pool;
+        int threadId{};
+        int completedDepth{};
+        Info lastResult{};
 };
 
+class ThreadPool {
+    public:
+        ThreadPool() {this->resize(1);};
+        ~ThreadPool();
+        void resize(int a_numThreads);
+        int size() const {return this->numThreads;};
+        void resizePawnCaches(uint64_t sizeMb);
+        void clearPawnCaches();
+        // pawn cache hits and probes summed over every thread since the last clear
+        std::pair<uint64_t, uint64_t> getPawnCacheStats() const;
+        void clearHistories();
+        // blocks until the search is done; used by bench and other synchronous callers
+        Info startThinking(const Board& board, Timeman::TimeManager tm, int depthLimit, bool printInfo = true);
+        // searches on a dedicated thread and prints bestmove when done; the uci loop stays responsive
+        void go(const Board& board, Timeman::TimeManager tm, int depthLimit, bool a_infinite, bool ponder);
+        void wait();
+        uint64_t getNodes() const;
+
+        bool stopped() const {return this->stopFlag.load(std::memory_order_relaxed);};
+        bool isPondering() const {return this->pondering.load(std::memory_order_relaxed);};
+        void stop();
+        void ponderhit();
+    private:
+        Info search(const Board& board, Timeman::TimeManager tm, int depthLimit, bool printInfo);
+
+        std::vector<std::unique_ptr<Searcher>> searchers;
+        // per-thread caches outlive the searchers so they stay warm between searches
+        std::vector<std::unique_ptr<Eval::PawnCache>> pawnCaches;
+        uint64_t pawnCacheMb = Eval::DEFAULT_PAWN_HASH_MB;
+        // move ordering histories carry over between searches of a game and are aged at the start of each one
+        std::vector<std::unique_ptr<MoveOrder::Histories>> histories;
+        std::atomic<bool> stopFlag{};
+        std::atomic<bool> pondering{};
+        bool infinite{};
+        int numThreads{};
+
+        std::thread mainThread;
+        std::mutex mutex;
+        std::condition_variable stopCondition;
+};
+
+// global declaration
+extern ThreadPool Threads;
+
 } // namespace Search
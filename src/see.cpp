@@ -0,0 +1,127 @@
+/*
+* Blocky, a UCI chess engine
+* Copyright (C) 2023-2024, Kevin Nguyen
+*
+* Blocky is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* Blocky is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, see <https://www.gnu.org/licenses>.
+*/
+
+#include "see.hpp"
+#include "attacks.hpp"
+#include "bitboard.hpp"
+
+namespace SEE {
+
+uint64_t attackersTo(const Board& board, Square square, uint64_t occupancy) {
+    const PieceSets& pieceSets = board.pieceSets;
+    const uint64_t bishopsQueens = pieceSets.get(BISHOP) | pieceSets.get(QUEEN);
+    const uint64_t rooksQueens = pieceSets.get(ROOK) | pieceSets.get(QUEEN);
+
+    // a white pawn attacks square from where a black pawn on square would attack, and vice versa
+    return (Attacks::pawnAttacks(square, false) & pieceSets.get(PAWN, true))
+         | (Attacks::pawnAttacks(square, true) & pieceSets.get(PAWN, false))
+         | (Attacks::knightAttacks(square) & pieceSets.get(KNIGHT))
+         | (Attacks::kingAttacks(square) & pieceSets.get(KING))
+         | (Attacks::bishopAttacks(square, occupancy) & bishopsQueens)
+         | (Attacks::rookAttacks(square, occupancy) & rooksQueens);
+}
+
+bool isAtLeast(const Board& board, Move move, int threshold) {
+    const Square from = move.sqr1();
+    const Square to = move.sqr2();
+    const pieceTypes attacker = board.getPiece(from);
+    const pieceTypes promotion = move.promotePiece();
+    const bool isEnPassant = (attacker == WPawn || attacker == BPawn) && to == board.enPassSquare();
+    const pieceTypes victim = isEnPassant ? (board.isWhiteTurn() ? BPawn : WPawn) : board.getPiece(to);
+
+    // the gain of the move itself must already reach the threshold
+    int swap = (victim != EmptyPiece ? pieceVals[victim] : 0) - threshold;
+    if (promotion != EmptyPiece) {
+        swap += pieceVals[promotion] - pieceVals[PAWN];
+    }
+    if (swap < 0) {
+        return false;
+    }
+
+    // even if the moved piece is lost for nothing, the threshold is still reached
+    swap = pieceVals[promotion != EmptyPiece ? promotion : attacker] - swap;
+    if (swap <= 0) {
+        return true;
+    }
+
+    const PieceSets& pieceSets = board.pieceSets;
+    uint64_t occupancy = pieceSets.get(ALL) ^ (c_u64(1) << from) ^ (c_u64(1) << to);
+    if (isEnPassant) {
+        occupancy ^= c_u64(1) << (to + (board.isWhiteTurn() ? 8 : -8));
+    }
+    const uint64_t bishopsQueens = pieceSets.get(BISHOP) | pieceSets.get(QUEEN);
+    const uint64_t rooksQueens = pieceSets.get(ROOK) | pieceSets.get(QUEEN);
+    uint64_t attackers = attackersTo(board, to, occupancy);
+
+    bool isWhite = board.isWhiteTurn();
+    bool result = true;
+    while (true) {
+        isWhite = !isWhite;
+        attackers &= occupancy;
+        const uint64_t sideAttackers = attackers & pieceSets.get(ALL, isWhite);
+        if (!sideAttackers) {
+            break;
+        }
+        result = !result;
+
+        // recapture with the least valuable attacker; removing it may uncover an x-ray slider
+        uint64_t pieces;
+        if ((pieces = sideAttackers & pieceSets.get(PAWN))) {
+            if ((swap = pieceVals[PAWN] - swap) < static_cast<int>(result)) {
+                break;
+            }
+            occupancy ^= pieces & -pieces;
+            attackers |= Attacks::bishopAttacks(to, occupancy) & bishopsQueens;
+        }
+        else if ((pieces = sideAttackers & pieceSets.get(KNIGHT))) {
+            if ((swap = pieceVals[KNIGHT] - swap) < static_cast<int>(result)) {
+                break;
+            }
+            occupancy ^= pieces & -pieces;
+        }
+        else if ((pieces = sideAttackers & pieceSets.get(BISHOP))) {
+            if ((swap = pieceVals[BISHOP] - swap) < static_cast<int>(result)) {
+                break;
+            }
+            occupancy ^= pieces & -pieces;
+            attackers |= Attacks::bishopAttacks(to, occupancy) & bishopsQueens;
+        }
+        else if ((pieces = sideAttackers & pieceSets.get(ROOK))) {
+            if ((swap = pieceVals[ROOK] - swap) < static_cast<int>(result)) {
+                break;
+            }
+            occupancy ^= pieces & -pieces;
+            attackers |= Attacks::rookAttacks(to, occupancy) & rooksQueens;
+        }
+        else if ((pieces = sideAttackers & pieceSets.get(QUEEN))) {
+            if ((swap = pieceVals[QUEEN] - swap) < static_cast<int>(result)) {
+                break;
+            }
+            occupancy ^= pieces & -pieces;
+            attackers |= (Attacks::bishopAttacks(to, occupancy) & bishopsQueens)
+                       | (Attacks::rookAttacks(to, occupancy) & rooksQueens);
+        }
+        else {
+            // the king may only recapture if the opponent has no attackers left
+            return (attackers & ~pieceSets.get(ALL, isWhite)) ? !result : result;
+        }
+    }
+    return result;
+}
+
+} // namespace SEE
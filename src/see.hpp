@@ -0,0 +1,63 @@
+/*
+* Blocky, a UCI chess engine
+* Copyright (C) 2023-2024, Kevin Nguyen
+*
+* Blocky is free software; you can redistribute it and/or modify it
+* under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* Blocky is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along with this program;
+* if not, see <https://www.gnu.org/licenses>.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "board.hpp"
+#include "eval.hpp"
+#include "move.hpp"
+#include "utils/types.hpp"
+
+// static exchange evaluation resolves the sequence of captures on a move's target square
+// without searching it, cheapest attacker first; sliders behind the capturers join in as x-rays
+namespace SEE {
+
+// pieces change squares during an exchange, so SEE needs values that don't depend on the square;
+// Eval::pieceVals are only the offsets the PSQT was tuned around, so each value is instead the PSQT
+// averaged over every square a piece can stand on and both phases
+// indices are equal to the enumerated pieceTypes; kings are never actually captured
+inline constexpr auto pieceVals = [] {
+    std::array<int, NUM_COLORED_PIECES> values{};
+    for (int piece = 0; piece < NUM_PIECES; ++piece) {
+        if (piece == KING) {
+            continue;
+        }
+        int total = 0, squares = 0;
+        for (Square square = 0; square < BOARD_SIZE; ++square) {
+            // pawns never stand on the first or last rank
+            if (piece == PAWN && (square < 8 || square >= 56)) {
+                continue;
+            }
+            total += Eval::PSQT[piece][square].opScore + Eval::PSQT[piece][square].egScore;
+            squares += 2;
+        }
+        values[piece] = values[piece + BKing] = total / squares;
+    }
+    return values;
+}();
+
+// returns whether the exchange started by move wins at least threshold centipawns for the side to move
+bool isAtLeast(const Board& board, Move move, int threshold);
+
+// every piece of either color attacking square given the occupancy
+uint64_t attackersTo(const Board& board, Square square, uint64_t occupancy);
+
+} // namespace SEE
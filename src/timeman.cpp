@@ -50,4 +50,8 @@ int64_t TimeManager::getTimeElapsed() const {
     return duration_cast<milliseconds>(currTime - startTime).count();
 }
 
+void TimeManager::restart() {
+    this->startTime = high_resolution_clock::now();
+}
+
 } // namespace Timeman
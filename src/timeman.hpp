@@ -33,6 +33,8 @@ class TimeManager
         bool hardTimeUp() const;
         bool softTimeUp() const;
         int64_t getTimeElapsed() const;
+        // limits are measured from now on; used when a ponder search becomes a normal one
+        void restart();
 
     private:
         std::chrono::system_clock::time_point startTime;
@@ -16,10 +16,19 @@
 * if not, see <https://www.gnu.org/licenses>.
 */
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <new>
+#include <thread>
 #include <vector>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
 #include "bitboard.hpp"
 #include "ttable.hpp"
 #include "move.hpp"
@@ -29,56 +38,175 @@ namespace TTable {
 // global definition
 TTable Table = TTable();
 
-void TTable::resize(int sizeMb) {
-    // sizeof uses bytes and not megabytes
-    this->size = sizeMb * 1024 * 1024 / sizeof(Entry);
-    this->table.resize(this->size);
+namespace {
+
+void* alignedAlloc(size_t alignment, size_t size) {
+#if defined(_WIN32)
+    return _aligned_malloc(size, alignment);
+#else
+    return std::aligned_alloc(alignment, size);
+#endif
 }
 
-void TTable::clear() {
-    std::fill(this->table.begin(), this->table.end(), Entry());
+void alignedFree(void* ptr) {
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
 }
 
-// estimates how much the table is full in tenths of percents
-int TTable::hashFull() {
-    int entriesUsed = 0;
-    for (int i = 0; i < 1000; ++i) {
-        if (this->table[i].move) {
-            ++entriesUsed;
+} // namespace
+
+int clearThreads() {
+    return std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, MAX_CLEAR_THREADS);
+}
+
+TTable::~TTable() {
+    alignedFree(this->table);
+}
+
+void TTable::resize(uint64_t sizeMb, int numThreads) {
+    alignedFree(this->table);
+    this->table = nullptr;
+
+    // if the system can't provide the requested memory, keep halving the request until it can
+    sizeMb = std::clamp(sizeMb, MIN_SIZEMB, MAX_SIZEMB);
+    while (!this->allocate(sizeMb * 1024 * 1024)) {
+        if (sizeMb <= MIN_SIZEMB) {
+            throw std::bad_alloc();
         }
+        sizeMb /= 2;
     }
-    return entriesUsed;
+
+    // memory is only committed once it is touched, so clearing is also what maps in the pages
+    this->clear(numThreads);
 }
 
-bool TTable::entryExists(uint64_t key) const {
-    const int index = this->getIndex(key);
-    return key == this->table[index].key;
+bool TTable::allocate(uint64_t bytes) {
+    this->numBuckets = bytes / sizeof(Bucket);
+    bytes = this->numBuckets * sizeof(Bucket);
+
+    // aligned_alloc requires the size to be a multiple of the alignment
+    const uint64_t hugePageBytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    this->table = static_cast<Bucket*>(alignedAlloc(HUGE_PAGE_SIZE, hugePageBytes));
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // only a hint; regular pages are used if transparent huge pages are unavailable
+    if (this->table) {
+        madvise(this->table, hugePageBytes, MADV_HUGEPAGE);
+    }
+#endif
+    // fall back to cache line alignment if huge page alignment can't be satisfied
+    if (!this->table) {
+        this->table = static_cast<Bucket*>(alignedAlloc(alignof(Bucket), bytes));
+    }
+
+    // padding past the last bucket is never touched, so it is never committed
+    this->allocatedBytes = this->table ? bytes : 0;
+    return this->table != nullptr;
 }
 
-Entry TTable::getEntry(uint64_t key) const {
-    return this->table[this->getIndex(key)];
+void TTable::clear(int numThreads) {
+    // large tables take seconds to zero on a single thread, so split the table into chunks
+    numThreads = std::max(numThreads, 1);
+    const uint64_t chunkSize = (this->numBuckets + numThreads - 1) / numThreads;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < numThreads; ++i) {
+        const uint64_t start = std::min(this->numBuckets, i * chunkSize);
+        const uint64_t end = std::min(this->numBuckets, start + chunkSize);
+        workers.emplace_back([this, start, end] {
+            std::memset(static_cast<void*>(this->table + start), 0, (end - start) * sizeof(Bucket));
+        });
+    }
+    for (auto& worker: workers) {
+        worker.join();
+    }
+    this->generation = 0;
+}
+
+// entries from older searches are preferred for replacement
+void TTable::newSearch() {
+    this->generation = (this->generation + 1) % GENERATION_CYCLE;
 }
 
-void TTable::store(int eval, Move move, EvalType bound, int depth, uint64_t key) {
-    Entry& entry = this->table[this->getIndex(key)];
-    if (true) {
-        entry.eval = eval;
-        entry.move = move;
-        entry.bound = bound;
-        entry.depth = depth;
-        entry.key = key;
+// estimates how much the table is full in tenths of percents
+// only entries written by the current search count; older entries are free to be replaced
+int TTable::hashFull() const {
+    const uint64_t sampledBuckets = std::min<uint64_t>((1000 + BUCKET_SIZE - 1) / BUCKET_SIZE, this->numBuckets);
+    uint64_t entriesUsed = 0;
+    for (uint64_t i = 0; i < sampledBuckets; ++i) {
+        for (const auto& entry: this->table[i].entries) {
+            if (!entry.isEmpty() && entry.getAge() == this->generation) {
+                ++entriesUsed;
+            }
+        }
+    }
+    // scaled by the entries actually scanned so that a full table reports 1000
+    return static_cast<int>(entriesUsed * 1000 / (sampledBuckets * BUCKET_SIZE));
+}
+
+bool TTable::probe(uint64_t key, Entry& entry) const {
+    const uint16_t key16 = static_cast<uint16_t>(key);
+    for (const auto& curr: this->table[this->getIndex(key)].entries) {
+        if (curr.key == key16 && !curr.isEmpty()) {
+            entry = curr;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TTable::store(int eval, int staticEval, Move move, EvalType bound, int depth, uint64_t key) {
+    const uint16_t key16 = static_cast<uint16_t>(key);
+    Bucket& bucket = this->table[this->getIndex(key)];
+
+    // replace the same position if found; otherwise replace the shallowest and oldest entry
+    Entry* replace = &bucket.entries[0];
+    for (auto& curr: bucket.entries) {
+        if (curr.key == key16 || curr.isEmpty()) {
+            replace = &curr;
+            break;
+        }
+        if (curr.getDepth() - 8 * this->relativeAge(curr) < replace->getDepth() - 8 * this->relativeAge(*replace)) {
+            replace = &curr;
+        }
+    }
+
+    // keep deeper results of the same position from the current search unless the new result is exact
+    if (replace->key == key16
+        && !replace->isEmpty()
+        && bound != EvalType::EXACT
+        && this->relativeAge(*replace) == 0
+        && depth + 3 < replace->getDepth()) {
+        return;
     }
+
+    // quiescence results may not have a move; keep the old one for the same position
+    if (move || replace->key != key16 || replace->isEmpty()) {
+        replace->move = move;
+    }
+    replace->key = key16;
+    replace->eval = static_cast<int16_t>(eval);
+    replace->staticEval = static_cast<int16_t>(staticEval);
+    replace->depth = static_cast<uint8_t>(depth + 1);
+    replace->boundAndAge = static_cast<uint8_t>(bound | (this->generation << 2));
 }
 
 void TTable::prefetch(uint64_t key) const {
-    if (this->table.empty()) {
+    if (!this->table) {
         return;
     }
     __builtin_prefetch(&this->table[getIndex(key)]);
 }
 
-int TTable::getIndex(uint64_t key) const {
-    return key % this->size;
+// maps the key onto the table with a multiply and shift instead of an expensive modulo
+uint64_t TTable::getIndex(uint64_t key) const {
+    return static_cast<uint64_t>((static_cast<__uint128_t>(key) * this->numBuckets) >> 64);
+}
+
+// number of searches since the entry was last written
+int TTable::relativeAge(const Entry& entry) const {
+    return (this->generation - entry.getAge() + GENERATION_CYCLE) % GENERATION_CYCLE;
 }
 
 } // namespace TTable
\ No newline at end of file
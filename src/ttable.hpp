@@ -18,42 +18,78 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <vector>
 
 #include "move.hpp"
 #include "utils/types.hpp"
 
 namespace TTable {
 
-inline constexpr int DEFAULT_SIZEMB = 128;
+inline constexpr uint64_t DEFAULT_SIZEMB = 128;
+inline constexpr uint64_t MIN_SIZEMB = 1;
+inline constexpr uint64_t MAX_SIZEMB = 65536;
+// aligning to huge pages lets the kernel back the table with 2 MiB pages, which greatly reduces TLB misses
+inline constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+inline constexpr int BUCKET_SIZE = 6;
+inline constexpr int GENERATION_BITS = 6;
+inline constexpr int GENERATION_CYCLE = 1 << GENERATION_BITS;
+// zeroing is bound by memory bandwidth, which more threads than this rarely improve
+inline constexpr int MAX_CLEAR_THREADS = 32;
 
+// packed into 10 bytes so that a whole bucket fits in one cache line
 struct Entry {
-    uint64_t key{};
-    int depth{};
-    int eval{};
-    EvalType bound = NONE;
+    uint16_t key{}; // lower bits of the zobrist key; the bucket index already accounts for the upper bits
     Move move{};
+    int16_t eval{}; // search score, only as accurate as the bound
+    int16_t staticEval{}; // raw evaluation of the position, saves calling evaluate() again
+    uint8_t depth{}; // stored with an offset of 1 so that 0 marks an empty entry
+    uint8_t boundAndAge{}; // bound in the lower 2 bits, generation in the upper 6 bits
+
+    int getDepth() const {return this->depth - 1;};
+    EvalType getBound() const {return static_cast<EvalType>(this->boundAndAge & 0b11);};
+    int getAge() const {return this->boundAndAge >> 2;};
+    bool isEmpty() const {return this->depth == 0;};
+};
+
+struct alignas(64) Bucket {
+    std::array<Entry, BUCKET_SIZE> entries{};
 };
 
+static_assert(sizeof(Entry) == 10);
+static_assert(sizeof(Bucket) == 64);
+
 class TTable {
     public:
-        void resize(int sizeMb);
+        void resize(uint64_t sizeMb, int numThreads = 1);
         TTable() {this->resize(DEFAULT_SIZEMB);};
-        void clear();
-        int hashFull();
+        ~TTable();
+        TTable(const TTable&) = delete;
+        TTable& operator=(const TTable&) = delete;
+        void clear(int numThreads = 1);
+        void newSearch();
+        int hashFull() const;
+        uint64_t getAllocatedBytes() const {return this->allocatedBytes;};
 
-        bool entryExists(uint64_t key) const;
-        Entry getEntry(uint64_t key) const;
-        void store(int eval, Move move, EvalType bound, int depth, uint64_t key);
+        bool probe(uint64_t key, Entry& entry) const;
+        void store(int eval, int staticEval, Move move, EvalType bound, int depth, uint64_t key);
         void prefetch(uint64_t key) const;
     private:
-        int getIndex(uint64_t key) const;
-        std::vector<Entry> table;
-        int size;
+        bool allocate(uint64_t bytes);
+        uint64_t getIndex(uint64_t key) const;
+        int relativeAge(const Entry& entry) const;
+
+        Bucket* table{};
+        uint64_t numBuckets{};
+        uint64_t allocatedBytes{};
+        uint8_t generation{};
 };
 
 // global declaration
 extern TTable Table;
 
+// clearing doesn't depend on the search thread count, so it uses every core up to MAX_CLEAR_THREADS
+int clearThreads();
+
 } // namespace TTable
\ No newline at end of file
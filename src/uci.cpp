@@ -16,9 +16,12 @@
 * if not, see <https://www.gnu.org/licenses>.
 */
 
+#include <algorithm>
 #include <cctype>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <new>
 #include <string>
 #include <sstream>
 #include <stdexcept>
@@ -28,6 +31,8 @@
 #include "bench.hpp"
 #include "timeman.hpp"
 #include "ttable.hpp"
+#include "eval.hpp"
+#include "nnue.hpp"
 #include "search.hpp"
 #include "moveOrder.hpp"
 #include "moveGen.hpp"
@@ -49,7 +54,13 @@ void printEngineInfo() {
     std::cout << "id author knguy22/intermittence, aqiu04\n";
 
     std::cout << "option name maxDepth type spin default 100 min 1 max 200\n";
-    std::cout << "option name Hash type spin default 128 min 128 max 1024\n";
+    std::cout << "option name Hash type spin default " << TTable::DEFAULT_SIZEMB
+              << " min " << TTable::MIN_SIZEMB << " max " << TTable::MAX_SIZEMB << '\n';
+    std::cout << "option name Threads type spin default 1 min " << Search::MIN_THREADS << " max " << Search::MAX_THREADS << '\n';
+    std::cout << "option name Ponder type check default false\n";
+    std::cout << "option name PawnHash type spin default " << Eval::DEFAULT_PAWN_HASH_MB
+              << " min " << Eval::MIN_PAWN_HASH_MB << " max " << Eval::MAX_PAWN_HASH_MB << '\n';
+    std::cout << "option name EvalFile type string default <empty>\n";
 
     std::cout << "uciok\n";
 }
@@ -75,13 +86,17 @@ void uciLoop() {
         commandStream >> commandToken;
 
         if (commandToken == "ucinewgame") {uciNewGame();}
+        else if (commandToken == "setoption") {setOption(commandStream);}
         else if (commandToken == "position") {currBoard = position(commandStream);}
         else if (commandToken == "go") {Uci::go(commandStream, currBoard);}
+        else if (commandToken == "stop") {Search::Threads.stop();}
+        else if (commandToken == "ponderhit") {Search::Threads.ponderhit();}
         else if (commandToken == "isready") {isready();}
         else if (commandToken == "bench") {bench();}
+        else if (commandToken == "pickbench") {pickBench();}
         else if (commandToken == "perft") {perft(commandStream, currBoard);}
         else if (commandToken == "magics") {magics();}
-        else if (commandToken == "quit") {return;}
+        else if (commandToken == "quit") {quit(); return;}
     }
 }
 
@@ -98,16 +113,53 @@ void setOption(std::istringstream& input){
     // uci requires id to not be case sensitive
     std::transform(id.begin(), id.end(), id.begin(), ::tolower);
 
+    // these options reallocate memory the search is using; the protocol only sends them while idle,
+    // so a search that is still running is stopped first instead of racing with it
+    if (id == "hash" || id == "threads" || id == "pawnhash" || id == "evalfile") {
+        Search::Threads.stop();
+        Search::Threads.wait();
+    }
+
     if (id == "maxdepth") {
         OPTIONS.depth = std::stoi(value);
     }
     else if (id == "hash") {
-        TTable::Table.resize(std::stoi(value));
+        // parsed as signed so that negative sizes clamp to the minimum instead of wrapping to the maximum
+        const int64_t sizeMb = std::clamp<int64_t>(std::stoll(value), TTable::MIN_SIZEMB, TTable::MAX_SIZEMB);
+        TTable::Table.resize(sizeMb, TTable::clearThreads());
+        const uint64_t allocatedMb = TTable::Table.getAllocatedBytes() / (1024 * 1024);
+        std::cout << "info string Hash allocated " << allocatedMb << " MB" << std::endl;
+    }
+    else if (id == "threads") {
+        // parsed as 64 bits so that huge requests clamp to the maximum instead of throwing
+        const int64_t numThreads = std::clamp<int64_t>(std::stoll(value), Search::MIN_THREADS, Search::MAX_THREADS);
+        Search::Threads.resize(static_cast<int>(numThreads));
+    }
+    else if (id == "pawnhash") {
+        const int64_t sizeMb = std::clamp<int64_t>(std::stoll(value), Eval::MIN_PAWN_HASH_MB, Eval::MAX_PAWN_HASH_MB);
+        Search::Threads.resizePawnCaches(sizeMb);
+    }
+    else if (id == "evalfile") {
+        // paths may contain spaces, so the rest of the line belongs to the value
+        std::string rest;
+        std::getline(input, rest);
+        value += rest;
+        if (value == "<empty>") {
+            value.clear();
+        }
+        if (NNUE::load(value)) {
+            std::cout << "info string using " << (NNUE::isLoaded() ? "network " + value : "hand-crafted evaluation") << std::endl;
+        }
     }
 }
 
 void uciNewGame() {
-    TTable::Table.clear();
+    // an infinite or ponder search only ends on stop, so it has to be stopped before waiting on it
+    Search::Threads.stop();
+    Search::Threads.wait();
+    TTable::Table.clear(TTable::clearThreads());
+    Search::Threads.clearPawnCaches();
+    Search::Threads.clearHistories();
 }
 
 Board position(std::istringstream& input) {
@@ -130,10 +182,9 @@ Board position(std::istringstream& input) {
     if (token != "moves") {return currBoard;}
     while (input >> token) {
         currBoard.makeMove(Move(token, currBoard.isWhiteTurn()));
-        // if a capture or castling rights change, clear move history since
-        // 3fold repetition or 50 move rule will be reset
-        // this makes things faster
-        if (currBoard.lastMoveCaptureOrCastle()) {
+        // if a capture, pawn move or castling rights change, clear move history since
+        // no earlier position can be repeated; this also keeps the history within MAX_GAME_PLY
+        if (currBoard.lastMoveCaptureOrCastle() || currBoard.fiftyMoveRule() == 0) {
             currBoard.clearHistory();
         }
     }
@@ -148,9 +199,15 @@ void go(std::istringstream& input, Board& board) {
     wtime = btime = Timeman::INF_TIME;
     winc = binc = 0;
 
+    // infinite and ponder searches only end after the gui sends stop or ponderhit
+    bool infinite = false, ponder = false;
+
     // input time parameters
     std::string param, value;
     while (input >> param) {
+        if (param == "infinite") {infinite = true; continue;}
+        if (param == "ponder") {ponder = true; continue;}
+
         input >> value;
         if (param == "wtime") {wtime = std::stoi(value);}
         else if (param == "btime") {btime = std::stoi(value);}
@@ -161,43 +218,77 @@ void go(std::istringstream& input, Board& board) {
     const int allyInc = board.isWhiteTurn() ? winc : binc;
     Timeman::TimeManager tm(allytime, allyInc);
 
-    // begin search
-    Search::Searcher currSearch(board, tm, OPTIONS.depth);
-    Search::Info result = currSearch.startThinking();
-    std::cout << "bestmove " << result.move.toStr() << "\n";
+    // begin search; bestmove is printed by the search thread
+    Search::Threads.go(board, tm, OPTIONS.depth, infinite, ponder);
 }
 
 void isready() {
-    std::cout << "readyok\n";
+    // flushed immediately since a search may be running in the background
+    std::cout << "readyok" << std::endl;
+}
+
+void quit() {
+    Search::Threads.stop();
+    Search::Threads.wait();
 }
 
 void bench() {
     uciNewGame(); // required to make benches consistent
+    const auto start = std::chrono::high_resolution_clock::now();
     const uint64_t result = Bench::start();
+    const auto end = std::chrono::high_resolution_clock::now();
+    const int64_t duration = std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), 1);
+    std::cout << "Bench time: " << duration / 1000 << " ms nps: " << result * 1000000 / duration << '\n';
+    const auto [pawnHits, pawnProbes] = Search::Threads.getPawnCacheStats();
+    std::cout << "Pawn hash hits: " << pawnHits * 100 / std::max<uint64_t>(pawnProbes, 1) << "% of " << pawnProbes << " probes\n";
     std::cout << "Bench results: " << result << '\n';
 }
 
+void pickBench() {
+    Bench::movePicker();
+}
+
 void perft(std::istringstream& input, Board& board) {
     // validate arguments
     std::string token;
     int depth;
+    int64_t hashMb = PERFT_HASH_MB;
     if (!(input >> token)) {
         std::cout << "ARGUMENT ERROR: Perft requires a depth to search to" << std::endl;
         return;
     }
     try {
         depth = std::stoi(token);
+        // an optional second argument sets the perft hash size in MB
+        // parsed as signed so that negative sizes are rejected instead of wrapping to huge ones
+        if (input >> token) {
+            hashMb = std::stoll(token);
+        }
     } 
     catch(std::exception& e) {
         std::cout << "ARGUMENT ERROR: Perft requires an integer to search to" << std::endl;
         return;
     }
+    if (hashMb < static_cast<int64_t>(TTable::MIN_SIZEMB) || hashMb > static_cast<int64_t>(TTable::MAX_SIZEMB)) {
+        std::cout << "ARGUMENT ERROR: Perft hash must be between " << TTable::MIN_SIZEMB
+                  << " and " << TTable::MAX_SIZEMB << " MB" << std::endl;
+        return;
+    }
     
     // perform perft
+    Search::Threads.stop();
+    Search::Threads.wait();
     const auto start = std::chrono::high_resolution_clock::now();
-    const uint64_t nodes = perft<true>(board, depth);
+    uint64_t nodes;
+    try {
+        nodes = parallelPerft(board, depth, Search::Threads.size(), hashMb);
+    }
+    catch(std::bad_alloc& e) {
+        std::cout << "ARGUMENT ERROR: Perft could not allocate a " << hashMb << " MB hash" << std::endl;
+        return;
+    }
     const auto end = std::chrono::high_resolution_clock::now();
-    const int64_t duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    const int64_t duration = std::max<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), 1);
     std::cout << "perft result nodes " << nodes;
     std::cout << " nps " << nodes * 1000000 / duration;
     std::cout << " time " << duration / 1000 << "\n";
@@ -39,9 +39,11 @@ void uciNewGame();
 Board position(std::istringstream& input);
 void go(std::istringstream& input, Board& board);
 void isready();
+void quit();
 
 // for debugging
 void bench();
+void pickBench();
 void perft(std::istringstream& input, Board& board);
 void magics();
 
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 
@@ -26,6 +27,17 @@
 template<typename T, std::size_t N>
 class FixedVector {
     public:
+        FixedVector() = default;
+        // copies only the used entries; the rest of the array is never read before it's written
+        constexpr FixedVector(const FixedVector<T, N>& other) : pointer(other.pointer) {
+            std::copy(other.begin(), other.end(), this->container.begin());
+        }
+        constexpr FixedVector& operator=(const FixedVector<T, N>& other) {
+            this->pointer = other.pointer;
+            std::copy(other.begin(), other.end(), this->container.begin());
+            return *this;
+        }
+
         // writing
         constexpr T& operator[](std::size_t index) {
             return this->container[index];
@@ -42,7 +54,7 @@ class FixedVector {
             // there is no need to null initialize the old memory since push_back is the only valid way to access it
             this->pointer--;
         }
-        constexpr T back() {
+        constexpr T back() const {
             return this->container[this->pointer];
         }
         constexpr auto begin() const {
@@ -54,6 +66,14 @@ class FixedVector {
         constexpr auto size() const {
             return this->pointer + 1;
         }
+        // removes the oldest count entries, keeping the rest in order
+        constexpr void dropFront(std::size_t count) {
+            std::copy(this->begin() + count, this->end(), this->container.begin());
+            this->pointer -= count;
+        }
+        constexpr auto capacity() const {
+            return N;
+        }
         constexpr auto clear() {
             // there is no need to null initialize the old memory since push_back is the only valid way to access it
             this->pointer = -1;
@@ -70,6 +90,7 @@ class FixedVector {
             return true;
         }
     private:
-        std::array<T, N> container{};
+        // left uninitialized when default constructed so that large vectors are cheap to create
+        std::array<T, N> container;
         std::size_t pointer = -1;
 };
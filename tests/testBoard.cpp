@@ -3,6 +3,7 @@
 #include "zobrist.hpp"
 
 #include <gtest/gtest.h>
+#include <array>
 #include <string>
 
 class BoardTest : public testing::Test {
@@ -450,4 +451,100 @@ TEST_F(BoardTest, moveIsCaptureTest) {
     EXPECT_EQ(b_12, true);
     EXPECT_EQ(b_13, false);
     EXPECT_EQ(b_14, true);
-}
\ No newline at end of file
+}
+
+TEST_F(BoardTest, isDrawThreefoldRepetition) {
+    Board board;
+    for (int i = 0; i < 2; ++i) {
+        board.makeMove(Move("g1f3", true));
+        board.makeMove(Move("g8f6", false));
+        board.makeMove(Move("f3g1", true));
+        ASSERT_FALSE(board.isDraw());
+        board.makeMove(Move("f6g8", false));
+    }
+    ASSERT_TRUE(board.isDraw());
+}
+
+TEST_F(BoardTest, isDrawRepetitionInSearch) {
+    Board board;
+    board.makeMove(Move("g1f3", true));
+    board.makeMove(Move("g8f6", false));
+    board.makeMove(Move("f3g1", true));
+    board.makeMove(Move("f6g8", false));
+    ASSERT_FALSE(board.isDraw(4));
+    ASSERT_TRUE(board.isDraw(5));
+}
+
+TEST_F(BoardTest, historyPastCapacityDropsOldestMoves) {
+    Board board;
+    const std::array<std::string, 4> shuffle = {"g1f3", "g8f6", "f3g1", "f6g8"};
+    const int plies = 2 * MAX_HISTORY;
+    for (int ply = 0; ply < plies; ++ply) {
+        board.makeMove(Move(shuffle[ply % 4], board.isWhiteTurn()));
+    }
+    // repetitions are still found and the latest moves can still be undone
+    ASSERT_TRUE(board.isDraw());
+    for (int ply = 0; ply < MAX_PLY + 2; ++ply) {
+        board.undoMove();
+    }
+    ASSERT_EQ(board.zobristKey(), Board().zobristKey());
+}
+
+TEST_F(BoardTest, checkInfoCachedAndInvalidated) {
+    Board board("4k3/8/8/8/8/8/4R3/4K3 b - - 0 1");
+    ASSERT_TRUE(board.inCheck());
+    ASSERT_EQ(board.checkers(), c_u64(1) << toSquare("e2"));
+    ASSERT_EQ(board.pinned(), 0);
+    ASSERT_TRUE(board.enemyAttacks() & (c_u64(1) << toSquare("e7")));
+
+    board.makeMove(Move("e8d8", false));
+    ASSERT_FALSE(board.inCheck());
+    board.undoMove();
+    ASSERT_TRUE(board.inCheck());
+}
+
+TEST_F(BoardTest, pinnedPieces) {
+    Board board("4k3/4r3/8/8/8/8/4N3/4K3 w - - 0 1");
+    ASSERT_FALSE(board.inCheck());
+    ASSERT_EQ(board.pinned(), c_u64(1) << toSquare("e2"));
+    ASSERT_FALSE(board.isLegalMove(Move("e2c3", true)));
+    ASSERT_TRUE(board.isLegalMove(Move("e1d1", true)));
+}
+
+TEST_F(BoardTest, lazyEvalMatchesFreshBoardPastStackDepth) {
+    // knights shuffle back and forth for more plies than the eval state stack holds
+    Board board("r1bqkbnr/pppppppp/2n5/8/8/5N2/PPPPPPPP/RNBQKB1R w KQkq - 2 2");
+    const int startEval = board.evaluate();
+    const std::array<std::string, 4> shuffle = {"f3g1", "c6b8", "g1f3", "b8c6"};
+    const int plies = 2 * EVAL_STACK_SIZE + 3;
+    for (int ply = 0; ply < plies; ++ply) {
+        board.makeMove(Move(shuffle[ply % 4], board.isWhiteTurn()));
+        if (ply % 7 == 0) {
+            ASSERT_EQ(board.evaluate(), Board(board.toFen()).evaluate());
+        }
+    }
+    for (int ply = 0; ply < plies; ++ply) {
+        board.undoMove();
+        if (ply % 5 == 0) {
+            ASSERT_EQ(board.evaluate(), Board(board.toFen()).evaluate());
+        }
+    }
+    ASSERT_EQ(board.evaluate(), startEval);
+}
+
+TEST_F(BoardTest, copiedBoardRebuildsEvalLazily) {
+    Board board("r1bqkbnr/pppppppp/2n5/8/8/5N2/PPPPPPPP/RNBQKB1R w KQkq - 2 2");
+    board.evaluate();
+    board.makeMove(Move("f3e5", true));
+
+    Board copy = board;
+    ASSERT_EQ(copy.evaluate(), board.evaluate());
+    copy.makeMove(Move("c6e5", false));
+    ASSERT_EQ(copy.evaluate(), Board(copy.toFen()).evaluate());
+    copy.undoMove();
+    copy.undoMove();
+    ASSERT_EQ(copy.evaluate(), Board("r1bqkbnr/pppppppp/2n5/8/8/5N2/PPPPPPPP/RNBQKB1R w KQkq - 2 2").evaluate());
+
+    copy = board;
+    ASSERT_EQ(copy.evaluate(), board.evaluate());
+}
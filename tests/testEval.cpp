@@ -109,3 +109,29 @@ TEST_F(EvalTest, bishopMobilityBlack) {
     const auto mobility = getPieceMobility(BISHOP, sq, mobilitySquares, allPieces);
     ASSERT_EQ(mobility, 6);
 }
+
+TEST_F(EvalTest, pawnCacheMatchesUncachedEval) {
+    const Board pos("r1bqkb1r/pp1p1ppp/2n2n2/2p1p1B1/2P5/2NP1N2/PP2PPPP/R2QKB1R b KQkq - 5 5");
+    PawnCache pawnCache(MIN_PAWN_HASH_MB);
+    ASSERT_EQ(pos.evaluate(pawnCache), pos.evaluate());
+    ASSERT_EQ(pos.evaluate(pawnCache), pos.evaluate());
+    ASSERT_EQ(pawnCache.getProbes(), 2);
+    ASSERT_EQ(pawnCache.getHits(), 1);
+}
+
+TEST_F(EvalTest, maxPieceValueBoundsCaptureGain) {
+    // the black queen stands on its most valuable square, so taking it gains more than pieceVals suggests
+    Board board("rnb1kbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBqR w KQkq - 0 1");
+    const int before = board.evaluate();
+    board.makeMove(Move("h1g1", true));
+    const int gain = -board.evaluate() - before;
+    ASSERT_GT(gain, std::max(pieceVals[QUEEN].opScore, pieceVals[QUEEN].egScore) + 200);
+    ASSERT_LE(gain, getMaxPieceValue(BQueen));
+
+    for (int piece = 0; piece < NUM_PIECES; ++piece) {
+        for (Square square = 0; square < BOARD_SIZE; ++square) {
+            ASSERT_LE(PSQT[piece][square].opScore, getMaxPieceValue(static_cast<pieceTypes>(piece)));
+            ASSERT_LE(PSQT[piece][square].egScore, getMaxPieceValue(static_cast<pieceTypes>(piece)));
+        }
+    }
+}
@@ -130,4 +130,63 @@ TEST_F(MoveGenTest, perftKiwipete) {
     ASSERT_EQ(perft<true>(board, 2), 2039);
     ASSERT_EQ(perft<true>(board, 3), 97862);
     ASSERT_EQ(perft<true>(board, 4), 4085603);
-}
\ No newline at end of file
+}
+
+TEST_F(MoveGenTest, perftPosition3) {
+    // pins and discovered checks through en passant
+    Board board("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");
+    ASSERT_EQ(perft<true>(board, 1), 14);
+    ASSERT_EQ(perft<true>(board, 2), 191);
+    ASSERT_EQ(perft<true>(board, 3), 2812);
+    ASSERT_EQ(perft<true>(board, 4), 43238);
+    ASSERT_EQ(perft<true>(board, 5), 674624);
+}
+
+TEST_F(MoveGenTest, perftPosition4) {
+    // starts in check with promotions available
+    Board board("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    ASSERT_EQ(perft<true>(board, 1), 6);
+    ASSERT_EQ(perft<true>(board, 2), 264);
+    ASSERT_EQ(perft<true>(board, 3), 9467);
+    ASSERT_EQ(perft<true>(board, 4), 422333);
+}
+
+TEST_F(MoveGenTest, perftPosition5) {
+    Board board("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8");
+    ASSERT_EQ(perft<true>(board, 1), 44);
+    ASSERT_EQ(perft<true>(board, 2), 1486);
+    ASSERT_EQ(perft<true>(board, 3), 62379);
+}
+
+TEST_F(MoveGenTest, parallelPerftMatchesPerft) {
+    Board board("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    ASSERT_EQ(parallelPerft(board, 1, 2, 1, false), 48);
+    ASSERT_EQ(parallelPerft(board, 3, 2, 1, false), 97862);
+    ASSERT_EQ(parallelPerft(board, 4, 4, 1, false), 4085603);
+}
+
+TEST_F(MoveGenTest, pseudoLegalMatchesGeneratedMoves) {
+    const std::vector<std::string> fens = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+    };
+    const std::vector<pieceTypes> promotions = {EmptyPiece, WQueen, WRook, WBishop, WKnight, BQueen, BRook, BBishop, BKnight};
+    for (const auto& fen: fens) {
+        Board board(fen);
+        MoveList gen(board);
+        gen.generateAllMoves(board);
+        for (int from = 0; from < BOARD_SIZE; ++from) {
+            for (int to = 0; to < BOARD_SIZE; ++to) {
+                for (const auto promotion: promotions) {
+                    const Move move(from, to, promotion);
+                    const bool generated = std::find(gen.moves.begin(), gen.moves.end(), move) != gen.moves.end();
+                    const bool legal = board.isPseudoLegalMove(move) && board.isLegalMove(move);
+                    ASSERT_EQ(generated, legal) << fen << ' ' << move;
+                }
+            }
+        }
+    }
+}
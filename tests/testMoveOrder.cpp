@@ -1,7 +1,9 @@
 #include "perft.hpp"
 #include "attacks.hpp"
+#include "see.hpp"
 
 #include <gtest/gtest.h>
+#include <memory>
 
 class MoveOrderTest : public testing::Test {
     public:
@@ -25,4 +27,117 @@ TEST_F(MoveOrderTest, perftKiwipete) {
     ASSERT_EQ(perftMovePicker<true>(board, 2), 2039);
     ASSERT_EQ(perftMovePicker<true>(board, 3), 97862);
     ASSERT_EQ(perftMovePicker<true>(board, 4), 4085603);
-}
\ No newline at end of file
+}
+
+TEST_F(MoveOrderTest, seeUndefendedCapture) {
+    Board board("1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1");
+    ASSERT_TRUE(SEE::isAtLeast(board, Move("e1e5", true), 0));
+    ASSERT_TRUE(SEE::isAtLeast(board, Move("e1e5", true), SEE::pieceVals[PAWN]));
+    ASSERT_FALSE(SEE::isAtLeast(board, Move("e1e5", true), SEE::pieceVals[PAWN] + 1));
+}
+
+TEST_F(MoveOrderTest, seeValuesFollowEvalOrdering) {
+    ASSERT_EQ(SEE::pieceVals[KING], 0);
+    ASSERT_LT(SEE::pieceVals[PAWN], SEE::pieceVals[KNIGHT]);
+    ASSERT_LT(SEE::pieceVals[KNIGHT], SEE::pieceVals[ROOK]);
+    ASSERT_LT(SEE::pieceVals[BISHOP], SEE::pieceVals[ROOK]);
+    ASSERT_LT(SEE::pieceVals[ROOK], SEE::pieceVals[QUEEN]);
+    for (int piece = 0; piece < NUM_PIECES; ++piece) {
+        ASSERT_EQ(SEE::pieceVals[piece], SEE::pieceVals[piece + BKing]);
+    }
+}
+
+TEST_F(MoveOrderTest, seeDefendedCapture) {
+    Board board("1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1");
+    ASSERT_FALSE(SEE::isAtLeast(board, Move("d3e5", true), 0));
+}
+
+TEST_F(MoveOrderTest, seeXrayRecapture) {
+    // the rook on e1 backs up the queen through the e-file, so the king can't recapture
+    Board board("8/3k4/4r3/8/8/8/4Q3/4R1K1 w - - 0 1");
+    ASSERT_TRUE(SEE::isAtLeast(board, Move("e2e6", true), 0));
+    Board noXray("8/3k4/4r3/8/8/8/4Q3/6K1 w - - 0 1");
+    ASSERT_FALSE(SEE::isAtLeast(noXray, Move("e2e6", true), 0));
+}
+
+TEST_F(MoveOrderTest, counterMovePickedBeforeQuiets) {
+    Board board;
+    static const MoveOrder::Histories histories{};
+    MoveOrder::MovePicker movePicker(MoveOrder::All, Move(), Move(), Move("g1f3", true));
+    ASSERT_TRUE(movePicker.movesLeft(board, histories));
+    ASSERT_EQ(movePicker.pickMove(), Move("g1f3", true));
+    // the counter move is not handed out a second time with the other quiets
+    int picked = 1;
+    while (movePicker.movesLeft(board, histories)) {
+        ASSERT_NE(movePicker.pickMove(), Move("g1f3", true));
+        ++picked;
+    }
+    ASSERT_EQ(picked, 20);
+}
+
+TEST_F(MoveOrderTest, ttPromotionClassifiedLikeGeneratedPromotion) {
+    Board board("k7/4P3/8/8/8/8/8/4K3 w - - 0 1");
+    static const MoveOrder::Histories histories{};
+
+    // queen promotions are generated with the captures, so they are searched in quiescence
+    MoveOrder::MovePicker capturesPicker(MoveOrder::Captures, Move("e7e8q", true));
+    ASSERT_TRUE(capturesPicker.movesLeft(board, histories));
+    ASSERT_EQ(capturesPicker.pickMove(), Move("e7e8q", true));
+    ASSERT_FALSE(capturesPicker.pickedQuiet());
+    ASSERT_FALSE(capturesPicker.movesLeft(board, histories));
+
+    // underpromotions are generated with the quiets
+    MoveOrder::MovePicker quietsPicker(MoveOrder::All, Move("e7e8n", true));
+    ASSERT_TRUE(quietsPicker.movesLeft(board, histories));
+    ASSERT_EQ(quietsPicker.pickMove(), Move("e7e8n", true));
+    ASSERT_TRUE(quietsPicker.pickedQuiet());
+    MoveOrder::MovePicker skippedPicker(MoveOrder::Captures, Move("e7e8n", true));
+    ASSERT_TRUE(skippedPicker.movesLeft(board, histories));
+    ASSERT_EQ(skippedPicker.pickMove(), Move("e7e8q", true));
+}
+
+TEST_F(MoveOrderTest, historyGravityStaysBounded) {
+    int entry = 0;
+    for (int i = 0; i < 1000; ++i) {
+        MoveOrder::updateHistory(entry, MoveOrder::historyBonus(MAX_PLY - 1));
+        ASSERT_LE(entry, MoveOrder::HISTORY_MAX);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        MoveOrder::updateHistory(entry, -MoveOrder::historyBonus(MAX_PLY - 1));
+        ASSERT_GE(entry, -MoveOrder::HISTORY_MAX);
+    }
+}
+
+TEST_F(MoveOrderTest, historiesDecayAndClear) {
+    auto histories = std::make_unique<MoveOrder::Histories>();
+    histories->butterfly[12][28] = 4000;
+    histories->capture[WKnight][36][PAWN] = -2000;
+    histories->continuation[WPawn][28][BKnight][45] = 1000;
+    histories->counterMoves[WPawn][28] = Move("g8f6", false);
+
+    histories->decay();
+    ASSERT_EQ(histories->butterfly[12][28], 4000 * MoveOrder::HISTORY_DECAY_NUM / MoveOrder::HISTORY_DECAY_DEN);
+    ASSERT_EQ(histories->capture[WKnight][36][PAWN], -2000 * MoveOrder::HISTORY_DECAY_NUM / MoveOrder::HISTORY_DECAY_DEN);
+    ASSERT_EQ(histories->continuation[WPawn][28][BKnight][45], 1000 * MoveOrder::HISTORY_DECAY_NUM / MoveOrder::HISTORY_DECAY_DEN);
+    ASSERT_EQ(histories->counterMoves[WPawn][28], Move("g8f6", false));
+
+    histories->clear();
+    ASSERT_EQ(histories->butterfly[12][28], 0);
+    ASSERT_EQ(histories->capture[WKnight][36][PAWN], 0);
+    ASSERT_EQ(histories->continuation[WPawn][28][BKnight][45], 0);
+    ASSERT_EQ(histories->counterMoves[WPawn][28], Move());
+}
+
+TEST_F(MoveOrderTest, captureHistoryKeepsVictimOrder) {
+    Board board("4k3/8/8/3n4/4P3/8/7K/Qr6 w - - 0 1");
+    auto histories = std::make_unique<MoveOrder::Histories>();
+    // even saturated histories only break ties between victims of the same value
+    histories->capture[WPawn][toSquare("d5")][KNIGHT] = MoveOrder::HISTORY_MAX;
+    histories->capture[WQueen][toSquare("b1")][ROOK] = -MoveOrder::HISTORY_MAX;
+
+    MoveOrder::MovePicker movePicker(MoveOrder::Captures);
+    ASSERT_TRUE(movePicker.movesLeft(board, *histories));
+    ASSERT_EQ(movePicker.pickMove(), Move("a1b1", true));
+    ASSERT_TRUE(movePicker.movesLeft(board, *histories));
+    ASSERT_EQ(movePicker.pickMove(), Move("e4d5", true));
+}
@@ -0,0 +1,77 @@
+#include "nnue.hpp"
+#include "board.hpp"
+#include "moveGen.hpp"
+#include "attacks.hpp"
+
+#include <gtest/gtest.h>
+#include <fstream>
+#include <random>
+#include <string>
+
+class NnueTest : public testing::Test {
+    public:
+        static void SetUpTestSuite() {
+            Attacks::init();
+        }
+        static void TearDownTestSuite() {
+            NNUE::unload();
+        }
+        // a network with small random weights in the expected file layout
+        static std::string writeRandomNetwork(int numValues) {
+            const std::string path = testing::TempDir() + "blocky_random.nnue";
+            std::ofstream file(path, std::ios::binary);
+            std::mt19937 rng(12345);
+            std::uniform_int_distribution<int> dist(-64, 64);
+            for (int i = 0; i < numValues; ++i) {
+                const int16_t value = static_cast<int16_t>(dist(rng));
+                file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+            return path;
+        }
+        static constexpr int NETWORK_VALUES = NNUE::INPUT_SIZE * NNUE::HIDDEN_SIZE + NNUE::HIDDEN_SIZE + 2 * NNUE::HIDDEN_SIZE + 1;
+};
+
+TEST_F(NnueTest, truncatedFileIsRejected) {
+    NNUE::unload();
+    ASSERT_FALSE(NNUE::load(writeRandomNetwork(NETWORK_VALUES - 1)));
+    ASSERT_FALSE(NNUE::isLoaded());
+}
+
+TEST_F(NnueTest, incrementalMatchesRefresh) {
+    ASSERT_TRUE(NNUE::load(writeRandomNetwork(NETWORK_VALUES)));
+    // kiwipete covers castling, en passant, and promotions within a few plies
+    Board board("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    const int startEval = board.evaluate();
+    int plies = 0;
+    for (; plies < 40; ++plies) {
+        MoveList moveList(board);
+        moveList.generateAllMoves(board);
+        if (moveList.moves.size() == 0) {
+            break;
+        }
+        board.makeMove(moveList.moves[(plies * 7) % moveList.moves.size()]);
+        ASSERT_EQ(board.evaluate(), Board(board.toFen()).evaluate());
+    }
+    for (; plies > 0; --plies) {
+        board.undoMove();
+    }
+    ASSERT_EQ(board.evaluate(), startEval);
+    NNUE::unload();
+}
+
+TEST_F(NnueTest, colorSymmetric) {
+    ASSERT_TRUE(NNUE::load(writeRandomNetwork(NETWORK_VALUES)));
+    const Board white("r1bqkb1r/pp1p1ppp/2n2n2/2p1p1B1/2P5/2NP1N2/PP2PPPP/R2QKB1R w - - 0 1");
+    const Board black("r2qkb1r/pp2pppp/2np1n2/2p5/2P1P1b1/2N2N2/PP1P1PPP/R1BQKB1R b - - 0 1");
+    ASSERT_EQ(white.evaluate(), black.evaluate());
+    NNUE::unload();
+}
+
+TEST_F(NnueTest, unloadFallsBackToHandCrafted) {
+    const Board before("r1bqkb1r/pp1p1ppp/2n2n2/2p1p1B1/2P5/2NP1N2/PP2PPPP/R2QKB1R w - - 0 1");
+    const int handCrafted = before.evaluate();
+    ASSERT_TRUE(NNUE::load(writeRandomNetwork(NETWORK_VALUES)));
+    ASSERT_TRUE(NNUE::load(""));
+    ASSERT_FALSE(NNUE::isLoaded());
+    ASSERT_EQ(before.evaluate(), handCrafted);
+}
@@ -0,0 +1,30 @@
+#include "search.hpp"
+#include "attacks.hpp"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+
+class SearchTest : public testing::Test {
+    public:
+        static void SetUpTestSuite() {
+            Attacks::init();
+            Search::initLMRTable();
+        }
+};
+
+TEST_F(SearchTest, ponderhitStartsTheClock) {
+    Search::ThreadPool pool;
+    const Board board;
+    // 2 seconds on the clock gives a hard limit of 100 ms and a soft limit of 33 ms
+    pool.go(board, Timeman::TimeManager(2000, 0), 100, false, true);
+    // pondering for longer than the hard limit must not use up our own time
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    const auto start = std::chrono::steady_clock::now();
+    pool.ponderhit();
+    pool.wait();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_GE(elapsed, 30);
+    EXPECT_LT(elapsed, 1000);
+}
@@ -1,9 +1,17 @@
+#include <algorithm>
 #include <cassert>
+#include <charconv>
+#include <cstring>
+#include <cmath>
+#include <deque>
 #include <fstream>
 #include <filesystem>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
 #include "extract.hpp"
@@ -17,56 +25,273 @@
 
 // This program is meant to convert the pgns from a Cutechess match into a data format
 // that is easy to parse; make sure not to have any incompleted games within those pgns
+// Destinations ending in .bin are written as packed binary records, anything else as fen text
+// Games are split into chunks that are extracted in parallel and written back in the order they were read
 
 RNGSeed seed = {0xf38f4541449b0fc3, 0x8432cf48703f8864, 0x1c8596ae5c1621d1, 0xf6d3be81a796f876};
 
 inline constexpr int MOD_FENS = 3;
+inline constexpr int GAMES_PER_CHUNK = 256;
+inline constexpr int CHUNKS_PER_THREAD = 4;
 
-int main() {
+int main(int argc, char* argv[]) {
     // initialize prerequisites
     Attacks::init();
     std::vector<std::string> pgns, dests;
     readFileNames(pgns, dests);
 
+    // the worker count can be given as the first argument, it defaults to every core
+    int threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    if (argc > 1) {
+        // the whole argument has to be a number; without workers the first chunk would never be extracted
+        const char* end = argv[1] + std::strlen(argv[1]);
+        const auto [ptr, ec] = std::from_chars(argv[1], end, threads);
+        if (ec != std::errc() || ptr != end || threads < 1) {
+            std::cerr << "Invalid thread count: " << argv[1] << '\n';
+            return 1;
+        }
+    }
+
     // print filenames
     std::cout << "Files to process:\n";
     assert(pgns.size() == dests.size());
-    for (int i = 0; i < pgns.size(); ++i) {
+    for (size_t i = 0; i < pgns.size(); ++i) {
         std::cout << "Pgn: " << pgns[i] << " Dest: " << dests[i] << '\n';
     }
-    std::cout << '\n';
+    std::cout << "Threads: " << threads << "\n\n";
+
+    // errors from the workers are reported once every worker has been joined
+    try {
+        const int games = extractFiles(pgns, dests, threads);
+        std::cout << "Total games processed: " << games << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Extraction failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
-    // main file reading loop
+// main file reading loop; chunks are parsed by the pool and written back in the order they were read
+int extractFiles(const std::vector<std::string>& pgns, const std::vector<std::string>& dests, int threads) {
+    // pending is declared first so that it outlives the pool; workers hold pointers into it until they're joined
+    std::deque<std::unique_ptr<Chunk>> pending;
+    WorkerPool pool(threads);
+    Destination dest;
     int games = 0;
-    for (int i = 0; i < dests.size(); ++i) {
-        const auto pgn = pgns[i];
-        const auto destName = dests[i];
-        std::cout << "Processing file: " << pgn << ", Dest: " << destName << std::endl;
-        extractFromFile(pgn, destName, games);
+    auto writeOldest = [&]() {
+        Chunk& chunk = *pending.front();
+        pool.wait(chunk);
+        if (chunk.fileIndex != dest.fileIndex) {
+            dest.open(dests[chunk.fileIndex], chunk.fileIndex);
+        }
+        dest.write(chunk);
+        if ((games + chunk.games) / 500 != games / 500) {
+            std::cout << "Games processed: " << games + chunk.games << std::endl;
+        }
+        games += chunk.games;
+        pending.pop_front();
+    };
+
+    for (size_t i = 0; i < pgns.size(); ++i) {
+        std::cout << "Processing file: " << pgns[i] << ", Dest: " << dests[i] << std::endl;
+        std::ifstream file(pgns[i]);
+        assert(file);
+
+        // every file yields at least one chunk, so that empty pgns still get a destination
+        std::string nextLine;
+        uint64_t chunkIndex = 0;
+        do {
+            auto chunk = std::make_unique<Chunk>();
+            chunk->fileIndex = static_cast<int>(i);
+            chunk->index = chunkIndex++;
+            chunk->packed = isPackedDest(dests[i]);
+            readChunk(file, nextLine, chunk->pgn);
+            pool.submit(*chunk);
+            pending.push_back(std::move(chunk));
+            // bounds the memory held by parsed but unwritten chunks
+            while (pending.size() >= static_cast<size_t>(threads) * CHUNKS_PER_THREAD) {
+                writeOldest();
+            }
+        } while (file);
     }
-    std::cout << "Total games processed: " << games << std::endl;
-    return 0;
+    while (!pending.empty()) {
+        writeOldest();
+    }
+    dest.close();
+    return games;
 }
 
-void extractFromFile(std::string pgn, std::string destName, int& games) {
-    std::ifstream file(pgn);
-    std::ofstream dest(destName);
-    assert(file);
-    assert(dest);
+bool isPackedDest(const std::string& destName) {
+    return std::filesystem::path(destName).extension() == ".bin";
+}
+
+// reads up to GAMES_PER_CHUNK whole games; a game starts at the first tag line after its predecessor's moves,
+// so that line is handed back through nextLine when the chunk is full
+void readChunk(std::istream& file, std::string& nextLine, std::string& pgn) {
+    std::string line;
+    int games = 0;
+    bool inTags = false;
+    while (!nextLine.empty() || std::getline(file, line)) {
+        if (!nextLine.empty()) {
+            line = std::move(nextLine);
+            nextLine.clear();
+        }
+        if (line.empty() || line == "\r") {
+            pgn += '\n';
+            continue;
+        }
+
+        const bool isTag = line[0] == '[';
+        if (isTag && !inTags) {
+            if (games == GAMES_PER_CHUNK) {
+                nextLine = std::move(line);
+                return;
+            }
+            ++games;
+        }
+        inTags = isTag;
+        pgn += line;
+        pgn += '\n';
+    }
+}
+
+// each chunk draws from its own stream derived from seed, so the stored positions don't depend on the thread count
+RNGSeed chunkSeed(int fileIndex, uint64_t chunkIndex) {
+    RNGSeed derived = seed;
+    uint64_t mix = (static_cast<uint64_t>(fileIndex) << 40) ^ chunkIndex;
+    for (auto& word: derived) {
+        // splitmix64
+        mix += 0x9e3779b97f4a7c15;
+        uint64_t z = mix;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        word ^= z ^ (z >> 31);
+    }
+    return derived;
+}
+
+void extractChunk(Chunk& chunk) {
+    std::istringstream file(chunk.pgn);
+    std::ostringstream fens;
+    RNGSeed rng = chunkSeed(chunk.fileIndex, chunk.index);
 
     while (!file.eof()) {
         bool blackStarts;
         const auto result = getGameResult(file);
         const auto startFen = getStartFen(file, blackStarts);
-        const auto fens = getPositions(file, startFen, result, blackStarts);
-        storeFenResults(dest, fens, result);
+        const auto positions = getPositions(file, startFen, result, blackStarts);
+        if (chunk.packed) {
+            storePackedResults(chunk.records, positions, result, rng);
+        } else {
+            storeFenResults(fens, positions, result, rng);
+        }
 
         if (result != NA) {
-            ++games;
+            ++chunk.games;
         }
-        if (games % 500 == 0) {
-            std::cout << "Games processed: " << games << std::endl;
+    }
+    chunk.fens = fens.str();
+    // the text is no longer needed once parsed
+    chunk.pgn = std::string();
+}
+
+WorkerPool::WorkerPool(int threadCount) {
+    for (int i = 0; i < threadCount; ++i) {
+        this->threads.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        // chunks that were never started are dropped, which only happens when extraction is aborted
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+        this->queue = {};
+    }
+    this->workAvailable.notify_all();
+    for (auto& thread: this->threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::submit(Chunk& chunk) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->queue.push(&chunk);
+    }
+    this->workAvailable.notify_one();
+}
+
+// blocks until the chunk is extracted; errors from the worker are rethrown here
+void WorkerPool::wait(Chunk& chunk) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->chunkDone.wait(lock, [&chunk]{return chunk.done;});
+    if (chunk.error) {
+        std::rethrow_exception(chunk.error);
+    }
+}
+
+void WorkerPool::work() {
+    while (true) {
+        Chunk* chunk;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->workAvailable.wait(lock, [this]{return this->stopping || !this->queue.empty();});
+            if (this->queue.empty()) {
+                return;
+            }
+            chunk = this->queue.front();
+            this->queue.pop();
         }
+
+        try {
+            extractChunk(*chunk);
+        } catch (...) {
+            chunk->error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            chunk->done = true;
+        }
+        this->chunkDone.notify_all();
+    }
+}
+
+void Destination::open(const std::string& destName, int a_fileIndex) {
+    // closes the previous destination first
+    this->close();
+
+    this->fileIndex = a_fileIndex;
+    this->name = destName;
+    if (isPackedDest(destName)) {
+        this->writer = std::make_unique<Packed::Writer>(destName);
+    } else {
+        this->fens.open(destName);
+        assert(this->fens);
+    }
+}
+
+void Destination::close() {
+    if (this->writer) {
+        this->writer->flush();
+        this->writer.reset();
+    }
+    if (this->fens.is_open()) {
+        this->fens.close();
+        if (!this->fens) {
+            throw std::runtime_error("Could not write to " + this->name);
+        }
+    }
+}
+
+void Destination::write(const Chunk& chunk) {
+    if (this->writer) {
+        for (const auto& record: chunk.records) {
+            this->writer->write(record);
+        }
+    } else {
+        this->fens << chunk.fens;
     }
 }
 
@@ -91,7 +316,7 @@ void readFileNames(std::vector<std::string>& pgns, std::vector<std::string>& des
     }
 }
 
-WinningColor getGameResult(std::ifstream& file) {
+WinningColor getGameResult(std::istream& file) {
     // Results are stored in the following form when using Cutechess: 
     // [Result "0-1"] or [Result "1/2-1/2"]
     std::string token;
@@ -118,7 +343,7 @@ WinningColor getGameResult(std::ifstream& file) {
 
 // for each game, there is a starting position, which can then be incremented with moves
 // some opening books use moves from startpos, others start from a fen
-std::string getStartFen(std::ifstream& file, bool& blackStarts) {
+std::string getStartFen(std::istream& file, bool& blackStarts) {
     std::string token, fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
     while (token != "1." && token != "1..." && !file.eof()) {
         file >> token;
@@ -142,18 +367,18 @@ std::string getStartFen(std::ifstream& file, bool& blackStarts) {
     return fen;
 }
 
-std::vector<std::string> getPositions(std::ifstream& file, std::string startFen, const WinningColor result, bool blackStarts) {
+std::vector<PositionEntry> getPositions(std::istream& file, std::string startFen, const WinningColor result, bool blackStarts) {
     // Games are generally stored in the following format:
     // 1. Nf3 {book} Nc6 {book} 2. b3 {book} d6 {book}
     // ...
     // 30. Ke2 {-M2/5 0.20s} Ng3# {+M1/5 0.20s, Black mates} 0-1
 
-    std::vector<std::string> fens;
+    std::vector<PositionEntry> positions;
     std::string token;
 
     // check for file open
     if (file.eof()) {
-        return fens;
+        return positions;
     }
 
     Board board(startFen);
@@ -165,16 +390,14 @@ std::vector<std::string> getPositions(std::ifstream& file, std::string startFen,
         // move
         file >> token;
         if (token == toStr(result)) {
-            return fens;
+            return positions;
         }
         move = getMove(token, board);
 
-        // move annotation
-        while (token.back() != '}') {
-            file >> token;
-        }
+        // move annotation; black moved, so the score is negated to be from white's point of view
+        const int16_t score = readAnnotation(file, token);
         if (token != "{book}") {
-            fens.push_back(fen);
+            positions.push_back({fen, score == Packed::NO_SCORE ? score : static_cast<int16_t>(-score)});
         }
 
         file >> token; // load the next move number
@@ -185,33 +408,54 @@ std::vector<std::string> getPositions(std::ifstream& file, std::string startFen,
         // two sides make moves
         for (int i = 0; i < 2; i++) {
             std::string fen = board.toFen();
+            const bool whiteMoves = board.isWhiteTurn();
             // move
             file >> token;
             if (token == toStr(result)) {
-                return fens;
+                return positions;
             }
             move = getMove(token, board);
 
             // move annotation
-            while (token.back() != '}') {
-                file >> token;
-            }
+            const int16_t score = readAnnotation(file, token);
             if (token != "{book}") {
-                fens.push_back(fen);
+                positions.push_back({fen, whiteMoves || score == Packed::NO_SCORE ? score : static_cast<int16_t>(-score)});
             }
         }
         file >> token; // load the next move number
     }
-    return fens;
+    return positions;
+}
+
+// Annotations look like {book} or {+0.35/12 0.20s}; token is left on the annotation's last token.
+// Returns the engine's score in centipawns for the side that moved, or NO_SCORE for book moves and mates.
+int16_t readAnnotation(std::istream& file, std::string& token) {
+    int16_t score = Packed::NO_SCORE;
+    bool first = true;
+    while (token.back() != '}') {
+        file >> token;
+        if (first && token.size() > 1 && token.find('M') == std::string::npos
+            && (token[1] == '+' || token[1] == '-' || isdigit(token[1]))) {
+            try {
+                const double pawns = std::stod(token.substr(1, token.find('/') - 1));
+                score = static_cast<int16_t>(std::clamp(std::lround(pawns * 100), -32000L, 32000L));
+            } catch (const std::exception&) {
+                score = Packed::NO_SCORE;
+            }
+        }
+        first = false;
+    }
+    return score;
 }
 
 Move getMove(std::string input, Board& board) {
+    // moves are never undone here, so drop history that can no longer repeat to stay within the board's capacity
+    if (board.fiftyMoveRule() == 0) {
+        board.clearHistory();
+    }
+
     MoveList gen(board);
     gen.generateAllMoves(board);
-    std::vector<Move> moves{};
-    for (const auto move: gen.moves) {
-        moves.push_back(move);
-    }
     std::string origInput = input;
 
     // checkmate or check (Ex: Ng3+), trim the last character
@@ -223,7 +467,7 @@ Move getMove(std::string input, Board& board) {
     if (input == "O-O" || input == "O-O-O") {
         int castleFile = input == "O-O" ? 6 : 2;
         pieceTypes allyKing = board.isWhiteTurn() ? WKing : BKing;
-        for (Move move: moves) {
+        for (const auto move: gen.moves) {
             if (board.getPiece(move.sqr1()) == allyKing 
                 && castleRightsBit(move.sqr2(), board.isWhiteTurn())
                 && getFile(move.sqr2()) == castleFile) {
@@ -275,64 +519,64 @@ Move getMove(std::string input, Board& board) {
     Square dest = toSquare(input);
 
     // filter moves
-    auto notCurrPiece = [board, currPiece](Move move) {
-        return board.getPiece(move.sqr1()) != currPiece;};
-    if (currPiece != EmptyPiece) {
-        moves.erase(std::remove_if(moves.begin(), moves.end(), notCurrPiece), moves.end());
-    }
-
-    auto notPromotePiece = [board, promotePiece](Move move) {
-        return move.promotePiece() != promotePiece;};
-    if (promotePiece != EmptyPiece) {
-        moves.erase(std::remove_if(moves.begin(), moves.end(), notPromotePiece), moves.end());
-    }
-    
-    auto notRank = [board, rank](Move move) {
-        return getRank(move.sqr1()) != rank;};
-    if (rank != -1) {
-        moves.erase(std::remove_if(moves.begin(), moves.end(), notRank), moves.end());
-    }
-    
-    auto notFile = [board, file](Move move) {
-        return getFile(move.sqr1()) != file;};
-    if (file != -1) {
-        moves.erase(std::remove_if(moves.begin(), moves.end(), notFile), moves.end());
+    Move selected;
+    int matches = 0;
+    for (const auto move: gen.moves) {
+        if (move.sqr2() != dest
+            || (currPiece != EmptyPiece && board.getPiece(move.sqr1()) != currPiece)
+            || (promotePiece != EmptyPiece && move.promotePiece() != promotePiece)
+            || (rank != -1 && getRank(move.sqr1()) != rank)
+            || (file != -1 && getFile(move.sqr1()) != file)) {
+            continue;
+        }
+        selected = move;
+        ++matches;
     }
 
-    auto notDest = [board, dest](Move move) {
-        return move.sqr2() != dest;
-    };
-    moves.erase(std::remove_if(moves.begin(), moves.end(), notDest), moves.end());
-
-    if (moves.size() != 1) {
-        std::cout << "Moves size: "<< moves.size() << std::endl;
+    if (matches != 1) {
+        std::cout << "Moves size: "<< matches << std::endl;
         throw std::runtime_error("Move not selected for: " + origInput + " with fen " + board.toFen());
     }
-    board.makeMove(moves[0]);
-    return moves[0];
+    board.makeMove(selected);
+    return selected;
 }
 
-void storeFenResults(std::ofstream& file, std::vector<std::string> fens, WinningColor result) {
+// filter unwanted positions
+bool isUsefulPosition(const Board& board) {
+    uint64_t nonPawns = board.pieceSets.get(ALL) ^ board.pieceSets.get(PAWN);
+    return popcount(nonPawns) > 4;
+}
+
+void storeFenResults(std::ostream& file, const std::vector<PositionEntry>& positions, WinningColor result, RNGSeed& rng) {
     if (result == NA) return;
 
     std::string resultStr = toStr(result);
-    int storedPositions = 0;
-    for (std::string fen: fens) {
+    for (const auto& position: positions) {
         // only accept 1 / MOD_FENS portion of total fens
-        if (!(rand64(seed) % MOD_FENS == 0)) {
+        if (!(rand64(rng) % MOD_FENS == 0)) {
+            continue;
+        }
+        if (!isUsefulPosition(Board(position.fen))) {
             continue;
         }
+        file << position.fen << "; [" << resultStr << "]\n";
+    }
+}
 
-        Board board(fen);
+// keeps exactly the same positions as storeFenResults, so both formats hold the same dataset
+void storePackedResults(std::vector<Packed::PackedBoard>& records, const std::vector<PositionEntry>& positions, WinningColor result, RNGSeed& rng) {
+    if (result == NA) return;
 
-        // filter unwanted positions
-        uint64_t nonPawns = board.pieceSets.get(ALL) ^ board.pieceSets.get(PAWN);
-        if (popcount(nonPawns) <= 4) {
+    const Packed::PackedResult packedResult = toPackedResult(result);
+    for (const auto& position: positions) {
+        if (!(rand64(rng) % MOD_FENS == 0)) {
             continue;
         }
-
-        file << fen << "; [" << resultStr << "]\n";
-        ++storedPositions;
+        const Board board(position.fen);
+        if (!isUsefulPosition(board)) {
+            continue;
+        }
+        records.push_back(Packed::pack(board, packedResult, position.score));
     }
 }
 
@@ -341,4 +585,11 @@ std::string toStr(const WinningColor result) {
     else if (result == DRAW) {return "1/2-1/2";}
     else if (result == BLACK) {return "0-1";}
     return "*";
+}
+
+Packed::PackedResult toPackedResult(const WinningColor result) {
+    assert(result != NA);
+    if (result == WHITE) {return Packed::WHITE_WIN;}
+    else if (result == BLACK) {return Packed::BLACK_WIN;}
+    return Packed::DRAW;
 }
\ No newline at end of file
@@ -1,21 +1,92 @@
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
 #include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <queue>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "board.hpp"
 #include "move.hpp"
+#include "packedBoard.hpp"
+#include "packedFile.hpp"
+#include "utils/types.hpp"
 
 enum WinningColor {
     WHITE, DRAW, BLACK, NA
 };
 
+struct PositionEntry {
+    std::string fen;
+    // engine score from white's point of view, or Packed::NO_SCORE
+    int16_t score;
+};
+
+// a run of consecutive games from one pgn; workers fill in the outputs
+struct Chunk {
+    int fileIndex;
+    uint64_t index;
+    bool packed;
+    std::string pgn;
+
+    std::string fens;
+    std::vector<Packed::PackedBoard> records;
+    int games = 0;
+    bool done = false;
+    std::exception_ptr error;
+};
+
+class WorkerPool {
+    public:
+        WorkerPool(int threadCount);
+        ~WorkerPool();
+        void submit(Chunk& chunk);
+        void wait(Chunk& chunk);
+    private:
+        void work();
+
+        std::vector<std::thread> threads;
+        std::queue<Chunk*> queue;
+        std::mutex mutex;
+        std::condition_variable workAvailable, chunkDone;
+        bool stopping = false;
+};
+
+// the output of one sources.csv entry
+class Destination {
+    public:
+        void open(const std::string& destName, int a_fileIndex);
+        void write(const Chunk& chunk);
+        // throws if anything written to the destination didn't make it to disk
+        void close();
+
+        int fileIndex = -1;
+    private:
+        std::string name;
+        std::ofstream fens;
+        std::unique_ptr<Packed::Writer> writer;
+};
+
 void readFileNames(std::vector<std::string>& pgns, std::vector<std::string>& dests);
-void extractFromFile(std::string pgn, std::string destName, int& games);
+int extractFiles(const std::vector<std::string>& pgns, const std::vector<std::string>& dests, int threads);
+bool isPackedDest(const std::string& destName);
+void readChunk(std::istream& file, std::string& nextLine, std::string& pgn);
+RNGSeed chunkSeed(int fileIndex, uint64_t chunkIndex);
+void extractChunk(Chunk& chunk);
 
-WinningColor getGameResult(std::ifstream& file);
-std::string getStartFen(std::ifstream& file, bool& blackStarts);
-std::vector<std::string> getPositions(std::ifstream& file, std::string startFen, const WinningColor result, bool blackStarts);
+WinningColor getGameResult(std::istream& file);
+std::string getStartFen(std::istream& file, bool& blackStarts);
+std::vector<PositionEntry> getPositions(std::istream& file, std::string startFen, const WinningColor result, bool blackStarts);
+int16_t readAnnotation(std::istream& file, std::string& token);
 
 Move getMove(std::string input, Board& board);
-void storeFenResults(std::ofstream& file, std::vector<std::string> fens, WinningColor result);
-std::string toStr(const WinningColor result);
\ No newline at end of file
+bool isUsefulPosition(const Board& board);
+void storeFenResults(std::ostream& file, const std::vector<PositionEntry>& positions, WinningColor result, RNGSeed& rng);
+void storePackedResults(std::vector<Packed::PackedBoard>& records, const std::vector<PositionEntry>& positions, WinningColor result, RNGSeed& rng);
+std::string toStr(const WinningColor result);
+Packed::PackedResult toPackedResult(const WinningColor result);
\ No newline at end of file
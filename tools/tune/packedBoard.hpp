@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "../../src/board.hpp"
+#include "../../src/bitboard.hpp"
+#include "../../src/move.hpp"
+#include "../../src/pieceSets.hpp"
+#include "../../src/utils/types.hpp"
+
+namespace Packed {
+
+// game results from white's point of view
+enum PackedResult: uint8_t {
+    BLACK_WIN, DRAW, WHITE_WIN
+};
+
+// marks a record without an engine score
+inline constexpr int16_t NO_SCORE = INT16_MIN;
+
+// A training position in 32 bytes instead of a 60-90 byte fen and result string.
+// Pieces take one nibble per occupied square, in square order starting from a8, low nibble first.
+// The layout is fixed so that files of records can be memory mapped and used in place.
+struct PackedBoard {
+    uint64_t occupancy;
+    std::array<uint8_t, 16> pieces;
+    // bit 7 is set when black is to move, the low 4 bits hold the castleRights
+    uint8_t flags;
+    // NULLSQUARE when there is none
+    uint8_t enPassSquare;
+    PackedResult result;
+    uint8_t reserved;
+    // centipawns from white's point of view, or NO_SCORE
+    int16_t score;
+    std::array<uint8_t, 2> padding;
+};
+static_assert(sizeof(PackedBoard) == 32);
+
+inline constexpr uint8_t BLACK_TO_MOVE = 0x80;
+
+// the raw arrays a position unpacks into; unpacking skips building a full Board, which is far slower
+struct UnpackedBoard {
+    std::array<pieceTypes, BOARD_SIZE> squares;
+    PieceSets pieceSets;
+    bool isWhiteTurn;
+};
+
+inline PackedBoard pack(const Board& board, PackedResult result = DRAW, int16_t score = NO_SCORE) {
+    PackedBoard packed{};
+    packed.result = result;
+    packed.score = score;
+    packed.occupancy = board.pieceSets.get(ALL);
+    uint64_t occupied = packed.occupancy;
+    for (int i = 0; occupied; ++i) {
+        const Square square = popLsb(occupied);
+        packed.pieces[i / 2] |= static_cast<uint8_t>(board.getPiece(square) << (4 * (i % 2)));
+    }
+    packed.flags = static_cast<uint8_t>(board.castlingRights() | (board.isWhiteTurn() ? 0 : BLACK_TO_MOVE));
+    packed.enPassSquare = board.enPassSquare();
+    return packed;
+}
+
+inline void unpack(const PackedBoard& packed, UnpackedBoard& unpacked) {
+    unpacked.squares.fill(EmptyPiece);
+    unpacked.pieceSets = PieceSets();
+    uint64_t occupied = packed.occupancy;
+    for (int i = 0; occupied; ++i) {
+        const Square square = popLsb(occupied);
+        const auto piece = static_cast<pieceTypes>((packed.pieces[i / 2] >> (4 * (i % 2))) & 0xF);
+        const uint64_t squareMask = c_u64(1) << square;
+        unpacked.squares[square] = piece;
+        unpacked.pieceSets[piece] |= squareMask;
+        unpacked.pieceSets[piece < BKing ? WHITE_PIECES : BLACK_PIECES] |= squareMask;
+    }
+    unpacked.isWhiteTurn = !(packed.flags & BLACK_TO_MOVE);
+}
+
+} // namespace Packed
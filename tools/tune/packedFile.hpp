@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "packedBoard.hpp"
+
+namespace Packed {
+
+inline constexpr std::array<char, 8> FILE_MAGIC = {'B', 'L', 'K', 'Y', 'P', 'A', 'C', 'K'};
+inline constexpr uint32_t FILE_VERSION = 1;
+
+// every file starts with this header; it's as large as a record so that the records stay aligned
+struct FileHeader {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t recordSize;
+    std::array<uint8_t, 16> reserved;
+};
+static_assert(sizeof(FileHeader) == sizeof(PackedBoard));
+
+// appends records to a file through a fixed size buffer, so whole datasets never have to be held in memory
+class Writer {
+    public:
+        Writer(const std::string& a_path) : path(a_path), file(a_path, std::ios::binary | std::ios::trunc) {
+            if (!this->file) {
+                throw std::runtime_error("Could not open " + path + " for writing");
+            }
+            FileHeader header{};
+            header.magic = FILE_MAGIC;
+            header.version = FILE_VERSION;
+            header.recordSize = sizeof(PackedBoard);
+            this->file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            this->buffer.reserve(BUFFER_RECORDS);
+        };
+        // errors can't be reported from here, so callers that care about them flush explicitly first
+        ~Writer() {
+            try {
+                this->flush();
+            } catch (const std::exception&) {}
+        };
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        void write(const PackedBoard& record) {
+            this->buffer.push_back(record);
+            if (this->buffer.size() == BUFFER_RECORDS) {
+                this->flush();
+            }
+        };
+        void flush() {
+            this->file.write(reinterpret_cast<const char*>(this->buffer.data()), this->buffer.size() * sizeof(PackedBoard));
+            this->file.flush();
+            // a short write such as a full disk would otherwise leave a silently truncated dataset
+            if (!this->file) {
+                throw std::runtime_error("Could not write to " + this->path);
+            }
+            this->written += this->buffer.size();
+            this->buffer.clear();
+        };
+        uint64_t getWritten() const {return this->written + this->buffer.size();};
+    private:
+        static constexpr size_t BUFFER_RECORDS = 1 << 16;
+
+        std::string path;
+        std::ofstream file;
+        std::vector<PackedBoard> buffer;
+        uint64_t written{};
+};
+
+// maps a whole file of records into memory so they can be used in place without parsing or copying
+// platforms without mmap read the file into memory instead
+class MappedReader {
+    public:
+        MappedReader(const std::string& path) {
+#if defined(_WIN32)
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file) {
+                throw std::runtime_error("Could not open " + path);
+            }
+            this->length = static_cast<size_t>(file.tellg());
+            this->fallback.resize(this->length / sizeof(PackedBoard) + 1);
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(this->fallback.data()), this->length);
+            this->mapping = this->fallback.data();
+#else
+            const int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("Could not open " + path);
+            }
+            struct stat info{};
+            fstat(fd, &info);
+            this->length = static_cast<size_t>(info.st_size);
+            if (this->length >= sizeof(FileHeader)) {
+                this->mapping = mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            close(fd);
+            if (this->mapping == MAP_FAILED) {
+                this->mapping = nullptr;
+                throw std::runtime_error("Could not map " + path);
+            }
+            // records are usually streamed through once from start to end
+            if (this->mapping) {
+                madvise(this->mapping, this->length, MADV_SEQUENTIAL);
+            }
+#endif
+            try {
+                this->validate(path);
+            } catch (...) {
+                this->release();
+                throw;
+            }
+        };
+        ~MappedReader() {this->release();};
+        MappedReader(const MappedReader&) = delete;
+        MappedReader& operator=(const MappedReader&) = delete;
+
+        const PackedBoard* data() const {return this->records;};
+        size_t size() const {return this->count;};
+        const PackedBoard* begin() const {return this->records;};
+        const PackedBoard* end() const {return this->records + this->count;};
+        const PackedBoard& operator[](size_t index) const {return this->records[index];};
+    private:
+        void release() {
+#if !defined(_WIN32)
+            if (this->mapping) {
+                munmap(this->mapping, this->length);
+            }
+#endif
+            this->mapping = nullptr;
+        };
+        void validate(const std::string& path) {
+            FileHeader header{};
+            if (this->length < sizeof(FileHeader) || this->mapping == nullptr) {
+                throw std::runtime_error(path + " is too small to be a packed position file");
+            }
+            std::memcpy(&header, this->mapping, sizeof(header));
+            if (header.magic != FILE_MAGIC || header.version != FILE_VERSION || header.recordSize != sizeof(PackedBoard)) {
+                throw std::runtime_error(path + " is not a packed position file of version " + std::to_string(FILE_VERSION));
+            }
+            this->records = reinterpret_cast<const PackedBoard*>(static_cast<const char*>(this->mapping) + sizeof(FileHeader));
+            // a partially written last record is ignored
+            this->count = (this->length - sizeof(FileHeader)) / sizeof(PackedBoard);
+        };
+
+        void* mapping = nullptr;
+        size_t length{};
+        const PackedBoard* records = nullptr;
+        size_t count{};
+#if defined(_WIN32)
+        std::vector<PackedBoard> fallback;
+#endif
+};
+
+} // namespace Packed
@@ -46,6 +46,18 @@ parameters_t BlockyEval::get_initial_parameters() {
     pushSingleTerm(params, "bishopPair", Eval::bishopPair);
 
     totalSize = params.size();
+
+    // coefficients are written through the compile time offsets, so they must agree with the pushed tables
+    assert(offsets["knightMobility"] == Offsets::KNIGHT_MOBILITY);
+    assert(offsets["bishopMobility"] == Offsets::BISHOP_MOBILITY);
+    assert(offsets["rookMobility"] == Offsets::ROOK_MOBILITY);
+    assert(offsets["passedPawns"] == Offsets::PASSED_PAWNS);
+    assert(offsets["pieceVals"] == Offsets::PIECE_VALS);
+    assert(offsets["doubledPawns"] == Offsets::DOUBLED_PAWNS);
+    assert(offsets["chainedPawns"] == Offsets::CHAINED_PAWNS);
+    assert(offsets["phalanxPawns"] == Offsets::PHALANX_PAWNS);
+    assert(offsets["bishopPair"] == Offsets::BISHOP_PAIR);
+    assert(totalSize == Offsets::TOTAL);
     return params;
 }
 
@@ -86,92 +98,140 @@ void BlockyEval::pushEntry(parameters_t& parameters, Eval::S entry, const Eval::
     parameters.push_back(pair_t{op, eg});
 }
 
-EvalResult BlockyEval::get_fen_eval_result(const std::string& fen) {
-    Board board(fen);
-    EvalResult result;
-    const auto allPieces = board.pieceSets.get(ALL);
+// calls add(index, value) for every linear term of the position; white terms count positively, black negatively
+template<typename AddCoefficient>
+void BlockyEval::addCoefficients(const Packed::UnpackedBoard& position, AddCoefficient add) {
+    // indexed by the colorless piece; only knights, bishops, and rooks have mobility terms
+    constexpr std::array<int, NUM_PIECES> mobilityOffsets = {
+        -1, -1, Offsets::BISHOP_MOBILITY, Offsets::KNIGHT_MOBILITY, Offsets::ROOK_MOBILITY, -1};
 
-    /************
-     * Initialize coefficients to zero-weights, which should fit most of them
-    *************/
-    result.coefficients.resize(totalSize);
+    const PieceSets& pieceSets = position.pieceSets;
+    const uint64_t allPieces = pieceSets.get(ALL);
 
-    /************
-     * Assign non-zero linear weights to coefficients for the given position
-    *************/
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        const pieceTypes piece = board.getPiece(i);
-        // empty squares don't affect evaluation
-        if (piece == EmptyPiece) {
-            continue;
-        }
+    // per color information is shared by all of that color's pieces; index 1 is white
+    std::array<uint64_t, 2> mobilitySquares, enemyPawnSets, doubledPawnSets, chainedPawnSets, phalanxPawnSets;
+    for (const bool isWhite: {false, true}) {
+        const uint64_t allyPawnSet = pieceSets.get(PAWN, isWhite);
+        mobilitySquares[isWhite] = Eval::getMobilitySquares(pieceSets, isWhite);
+        enemyPawnSets[isWhite] = pieceSets.get(PAWN, !isWhite);
+        doubledPawnSets[isWhite] = Eval::getDoubledPawnsMask(allyPawnSet, isWhite);
+        chainedPawnSets[isWhite] = Eval::getChainedPawnsMask(allyPawnSet, isWhite);
+        phalanxPawnSets[isWhite] = Eval::getPhalanxPawnsMask(allyPawnSet);
+    }
+
+    uint64_t pieces = allPieces;
+    while (pieces) {
+        const Square i = popLsb(pieces);
+        const pieceTypes piece = position.squares[i];
+        const uint64_t squareMask = c_u64(1) << i;
 
         // helper information
         const bool isWhitePiece = piece >= WKing && piece <= WPawn;
         const int colorlessPiece = piece % 6;
-        const int pieceOffset = colorlessPiece * BOARD_SIZE;
+        const int occurences = isWhitePiece ? 1 : -1;
+
+        // white and black pieces use different eval indices in piece square tables
+        const int squareOffset = isWhitePiece ? i : i ^ 56;
+        add(Offsets::PSQT + colorlessPiece * BOARD_SIZE + squareOffset, occurences);
+        add(Offsets::PIECE_VALS + colorlessPiece, occurences);
 
         // pawn terms
-        int passedPawnFlag = 0, doubledPawnFlag = 0, chainedPawnFlag = 0, phalanxPawnFlag = 0;
-        if (colorlessPiece == WPawn) {
-            const uint64_t allyPawnSet = board.pieceSets.get(PAWN, isWhitePiece);
-            const uint64_t enemyPawnSet = board.pieceSets.get(PAWN, !isWhitePiece);
-            const uint64_t doubledPawnSet = Eval::getDoubledPawnsMask(allyPawnSet, isWhitePiece);
-            const uint64_t chainedPawnSet = Eval::getChainedPawnsMask(allyPawnSet, isWhitePiece);
-            const uint64_t phalanxPawnSet = Eval::getPhalanxPawnsMask(allyPawnSet);
-
-            passedPawnFlag = static_cast<int>(Eval::isPassedPawn(i, enemyPawnSet, isWhitePiece));
-            doubledPawnFlag = static_cast<int>(static_cast<bool>(doubledPawnSet & c_u64(1) << i));
-            chainedPawnFlag = static_cast<int>(static_cast<bool>(chainedPawnSet & c_u64(1) << i));
-            phalanxPawnFlag = static_cast<int>(static_cast<bool>(phalanxPawnSet & c_u64(1) << i));
+        if (colorlessPiece == PAWN) {
+            if (Eval::isPassedPawn(i, enemyPawnSets[isWhitePiece], isWhitePiece)) {
+                const int rankOffset = isWhitePiece ? getRank(i) : getRank(i) ^ 7;
+                add(Offsets::PASSED_PAWNS + rankOffset, occurences);
+            }
+            if (doubledPawnSets[isWhitePiece] & squareMask) {
+                add(Offsets::DOUBLED_PAWNS, occurences);
+            }
+            if (chainedPawnSets[isWhitePiece] & squareMask) {
+                add(Offsets::CHAINED_PAWNS, occurences);
+            }
+            if (phalanxPawnSets[isWhitePiece] & squareMask) {
+                add(Offsets::PHALANX_PAWNS, occurences);
+            }
         }
 
-        // determine mobilities
-        int mobilityFlag{}, mobility{}, mobilityOffset{};
-        if (colorlessPiece == KNIGHT || colorlessPiece == BISHOP || colorlessPiece == ROOK) {
-            mobilityFlag = 1;
-            const uint64_t mobilitySquares = Eval::getMobilitySquares(board.pieceSets, isWhitePiece);
-            mobility = Eval::getPieceMobility(static_cast<pieceTypes>(colorlessPiece), i, mobilitySquares, allPieces);
-            switch (colorlessPiece)
-            {
-            case KNIGHT:
-                mobilityOffset = offsets["knightMobility"];
-                break;
-            case BISHOP:
-                mobilityOffset = offsets["bishopMobility"];
-                break;
-            case ROOK:
-                mobilityOffset = offsets["rookMobility"];
-                break;
-            default:
-                assert(false);
-            }
+        // mobilities
+        if (mobilityOffsets[colorlessPiece] != -1) {
+            const int mobility = Eval::getPieceMobility(static_cast<pieceTypes>(colorlessPiece), i, mobilitySquares[isWhitePiece], allPieces);
+            add(mobilityOffsets[colorlessPiece] + mobility, occurences);
         }
+    }
 
-        // white and black pieces use different eval indices in piece square tables
-        const int squareOffset = isWhitePiece ? i : i ^ 56;
-        const int rankOffset = isWhitePiece ? getRank(i) : getRank(i) ^ 7;
-        const int occurences = isWhitePiece ? 1 : -1;
+    // misc coefficients
+    const int bishopPairFlag = Eval::isBishopPair(pieceSets.get(BISHOP, true)) -
+                               Eval::isBishopPair(pieceSets.get(BISHOP, false));
+    if (bishopPairFlag != 0) {
+        add(Offsets::BISHOP_PAIR, bishopPairFlag);
+    }
+}
 
-        // add the coefficients
-        result.coefficients[offsets["PSQT"] + pieceOffset + squareOffset] += occurences;
-        result.coefficients[offsets["pieceVals"] + colorlessPiece] += occurences;
-        result.coefficients[offsets["passedPawns"] + rankOffset] += passedPawnFlag * occurences;
-        result.coefficients[offsets["doubledPawns"]] += doubledPawnFlag * occurences;
-        result.coefficients[offsets["chainedPawns"]] += chainedPawnFlag * occurences;
-        result.coefficients[offsets["phalanxPawns"]] += phalanxPawnFlag * occurences;
-        result.coefficients[mobilityOffset + mobility] += mobilityFlag * occurences;
+// matches Board::evaluate with the hand-crafted evaluation, without building a Board
+int BlockyEval::getEval(const Packed::UnpackedBoard& position) {
+    Eval::Info info;
+    uint64_t pieces = position.pieceSets.get(ALL);
+    while (pieces) {
+        const Square square = popLsb(pieces);
+        info.addPiece(square, position.squares[square]);
     }
+    const int rawEval = info.getRawEval(position.pieceSets, position.isWhiteTurn);
+    return position.isWhiteTurn ? rawEval : -rawEval;
+}
 
-    // misc coefficients
-    int bishopPairFlag = Eval::isBishopPair(board.pieceSets.get(BISHOP, true)) - 
-                         Eval::isBishopPair(board.pieceSets.get(BISHOP, false));
-    result.coefficients[offsets["bishopPair"]] += bishopPairFlag;
+EvalResult BlockyEval::get_fen_eval_result(const std::string& fen) {
+    Board board(fen);
+    Packed::UnpackedBoard position;
+    Packed::unpack(Packed::pack(board), position);
 
+    EvalResult result;
+    result.coefficients.resize(totalSize);
+    addCoefficients(position, [&](int index, int value) {
+        result.coefficients[index] += value;
+    });
     result.score = board.evaluate();
     return result;
 }
 
+BatchEvalResult BlockyEval::get_batch_eval_results(const Packed::PackedBoard* positions, size_t count) {
+    BatchEvalResult result;
+    // a typical position only touches a few dozen parameters
+    result.coefficients.reserve(count * 48);
+    result.offsets.reserve(count + 1);
+    result.scores.reserve(count);
+    result.offsets.push_back(0);
+
+    // coefficients are summed in a small dense array, then only the touched entries are emitted and reset
+    std::array<int16_t, Offsets::TOTAL> dense{};
+    std::array<bool, Offsets::TOTAL> isTouched{};
+    std::vector<int32_t> touched;
+    touched.reserve(Offsets::TOTAL);
+
+    Packed::UnpackedBoard position;
+    for (size_t i = 0; i < count; ++i) {
+        Packed::unpack(positions[i], position);
+        addCoefficients(position, [&](int index, int value) {
+            dense[index] += value;
+            if (!isTouched[index]) {
+                isTouched[index] = true;
+                touched.push_back(index);
+            }
+        });
+
+        for (const int32_t index: touched) {
+            if (dense[index] != 0) {
+                result.coefficients.push_back(SparseCoefficient{index, dense[index]});
+            }
+            dense[index] = 0;
+            isTouched[index] = false;
+        }
+        touched.clear();
+        result.offsets.push_back(result.coefficients.size());
+        result.scores.push_back(getEval(position));
+    }
+    return result;
+}
+
 void BlockyEval::print_parameters(const parameters_t& parameters) {
     for (const auto tableName: tablesInOrder) {
         std::cout << tableName << ":\n";
@@ -1,14 +1,45 @@
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
 
 #include "texel-tuner/src/base.h"
 #include "texel-tuner/src/external/chess.hpp"
+#include "packedBoard.hpp"
+#include "packedFile.hpp"
 #include "../../src/eval.hpp"
 
 namespace Blocky {
 
+// parameter offsets, in the order get_initial_parameters pushes the tables
+namespace Offsets {
+inline constexpr int PSQT = 0;
+inline constexpr int KNIGHT_MOBILITY = PSQT + NUM_PIECES * BOARD_SIZE;
+inline constexpr int BISHOP_MOBILITY = KNIGHT_MOBILITY + Eval::knightMobility.size();
+inline constexpr int ROOK_MOBILITY = BISHOP_MOBILITY + Eval::bishopMobility.size();
+inline constexpr int PASSED_PAWNS = ROOK_MOBILITY + Eval::rookMobility.size();
+inline constexpr int PIECE_VALS = PASSED_PAWNS + Eval::passedPawn.size();
+inline constexpr int DOUBLED_PAWNS = PIECE_VALS + Eval::pieceVals.size();
+inline constexpr int CHAINED_PAWNS = DOUBLED_PAWNS + 1;
+inline constexpr int PHALANX_PAWNS = CHAINED_PAWNS + 1;
+inline constexpr int BISHOP_PAIR = PHALANX_PAWNS + 1;
+inline constexpr int TOTAL = BISHOP_PAIR + 1;
+} // namespace Offsets
+
+struct SparseCoefficient {
+    int32_t index;
+    int16_t value;
+};
+
+// coefficients of many positions at once; position i owns coefficients[offsets[i], offsets[i + 1])
+struct BatchEvalResult {
+    std::vector<SparseCoefficient> coefficients;
+    std::vector<size_t> offsets;
+    std::vector<tune_t> scores;
+};
+
 // This is an interface for a texel-tuner used for the development for Blocky:
 // https://github.com/GediminasMasaitis/texel-tuner
 class BlockyEval
@@ -19,6 +50,12 @@ class BlockyEval
 
         static parameters_t get_initial_parameters();
         static EvalResult get_fen_eval_result(const std::string& fen);
+        // one pass over packed positions without building a Board or a dense coefficient vector per position
+        static BatchEvalResult get_batch_eval_results(const Packed::PackedBoard* positions, size_t count);
+        // positions of a file written by extract are used straight from the mapping
+        static BatchEvalResult get_batch_eval_results(const Packed::MappedReader& reader) {
+            return get_batch_eval_results(reader.data(), reader.size());
+        };
         static EvalResult get_external_eval_result(const chess::Board& board); // unused
         static void print_parameters(const parameters_t& parameters);
     private: 
@@ -27,6 +64,9 @@ class BlockyEval
                                 const std::array<Eval::S, N>& table, const Eval::S adjustVal = Eval::S{});
         static void pushSingleTerm(parameters_t& parameters, std::string termName, const Eval::S& term);
         static void pushEntry(parameters_t& parameters, Eval::S entry, const Eval::S adjustVal = Eval::S{});
+        template<typename AddCoefficient>
+        static void addCoefficients(const Packed::UnpackedBoard& position, AddCoefficient add);
+        static int getEval(const Packed::UnpackedBoard& position);
 
         static std::map<std::string, int> offsets;
         static std::map<std::string, int> sizes;